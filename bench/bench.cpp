@@ -0,0 +1,262 @@
+// Benchmark of the C API on generated instances.
+// Also the training run of the PGO build (see CMakeLists.txt): the instances
+// cover grid, layered and bipartite graphs with every selection rule, a
+// batch of small graphs and a global minimum cut, so the profile reflects
+// the usual Discharge/Push/Relabel mix.
+//
+// Usage: cmaxflow_bench [scale] [repeat]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+#include "cmaxflow.h"
+
+struct Instance {
+  std::string name;
+  std::vector<int> src;
+  std::vector<int> dst;
+  std::vector<double> capacity;
+  int s;
+  int t;
+
+  void AddEdge(int u, int v, double c) {
+    src.push_back(u);
+    dst.push_back(v);
+    capacity.push_back(c);
+  }
+};
+
+// w x h grid with random capacities; the source feeds the first column and
+// the last column drains to the sink.
+static Instance Grid(int w, int h, unsigned int seed) {
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> cap(1, 100);
+  Instance g;
+  g.name = "grid";
+  const int dx[4] = {1, 0, -1, 0};
+  const int dy[4] = {0, 1, 0, -1};
+  for (int x = 0; x < w; x++) {
+    for (int y = 0; y < h; y++) {
+      for (int k = 0; k < 4; k++) {
+        int X = x + dx[k];
+        int Y = y + dy[k];
+        if (0 <= X && X < w && 0 <= Y && Y < h) {
+          g.AddEdge(x * h + y, X * h + Y, cap(rnd));
+        }
+      }
+    }
+  }
+  g.s = w * h;
+  g.t = w * h + 1;
+  for (int y = 0; y < h; y++) {
+    g.AddEdge(g.s, y, 1000);
+    g.AddEdge((w - 1) * h + y, g.t, 1000);
+  }
+  return g;
+}
+
+// Layers of the given width; every node has `degree` edges to random nodes
+// of the next layer and a few back edges, which make relabeling necessary.
+static Instance Layered(int layers, int width, int degree, unsigned int seed) {
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> node(0, width - 1);
+  std::uniform_int_distribution<int> cap(1, 1000);
+  Instance g;
+  g.name = "layered";
+  g.s = layers * width;
+  g.t = layers * width + 1;
+  for (int i = 0; i < width; i++) {
+    g.AddEdge(g.s, i, 10000);
+    g.AddEdge((layers - 1) * width + i, g.t, 10000);
+  }
+  for (int l = 0; l + 1 < layers; l++) {
+    for (int i = 0; i < width; i++) {
+      int u = l * width + i;
+      for (int k = 0; k < degree; k++) {
+        g.AddEdge(u, (l + 1) * width + node(rnd), cap(rnd));
+      }
+      if (l > 0 && i % 4 == 0) {
+        g.AddEdge(u, (l - 1) * width + node(rnd), cap(rnd));
+      }
+    }
+  }
+  return g;
+}
+
+// Unit-capacity bipartite matching graph solved by push-relabel.
+static Instance Bipartite(int n, int degree, unsigned int seed) {
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> node(0, n - 1);
+  Instance g;
+  g.name = "bipartite";
+  g.s = 2 * n;
+  g.t = 2 * n + 1;
+  for (int i = 0; i < n; i++) {
+    g.AddEdge(g.s, i, 1);
+    g.AddEdge(n + i, g.t, 1);
+    for (int k = 0; k < degree; k++) {
+      g.AddEdge(i, n + node(rnd), 1);
+    }
+  }
+  return g;
+}
+
+// Sparse random graph held together by a ring of unit edges (global minimum
+// cut 2). Most excess of a Hao-Orlin phase cannot reach the sink, which
+// made the global minimum cut quadratic before excess detection.
+static Instance Expander(int n, int degree, unsigned int seed) {
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> node(0, n - 1);
+  std::uniform_int_distribution<int> cap(1, 20);
+  Instance g;
+  g.name = "expander";
+  for (int u = 0; u < n; u++) {
+    g.AddEdge(u, (u + 1) % n, 1);
+    g.AddEdge((u + 1) % n, u, 1);
+    for (int k = 0; k < degree; k++) {
+      int v = node(rnd);
+      if (v != u) {
+        g.AddEdge(u, v, cap(rnd));
+      }
+    }
+  }
+  g.s = 0;
+  g.t = n / 2;
+  return g;
+}
+
+// Batch of small random graphs for cmaxflow_solve_batch: a ring with random
+// chords, from node 0 to the opposite node.
+struct Batch {
+  std::vector<int64_t> node_offsets;
+  std::vector<int64_t> edge_offsets;
+  std::vector<int> src;
+  std::vector<int> dst;
+  std::vector<double> capacity;
+  std::vector<int> sources;
+  std::vector<int> sinks;
+};
+
+static Batch SmallGraphs(int number, int n, unsigned int seed) {
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> node(0, n - 1);
+  std::uniform_int_distribution<int> cap(1, 9);
+  Batch b;
+  b.node_offsets.push_back(0);
+  b.edge_offsets.push_back(0);
+  for (int g = 0; g < number; g++) {
+    for (int u = 0; u < n; u++) {
+      b.src.push_back(u);
+      b.dst.push_back((u + 1) % n);
+      b.capacity.push_back(5);
+      for (int k = 0; k < 3; k++) {
+        b.src.push_back(u);
+        b.dst.push_back(node(rnd));
+        b.capacity.push_back(cap(rnd));
+      }
+    }
+    b.node_offsets.push_back(b.node_offsets.back() + n);
+    b.edge_offsets.push_back((int64_t) b.src.size());
+    b.sources.push_back(0);
+    b.sinks.push_back(n / 2);
+  }
+  return b;
+}
+
+int main(int argc, char** argv) {
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+  int repeat = argc > 2 ? std::atoi(argv[2]) : 1;
+  if (scale < 1) {
+    scale = 1;
+  }
+
+  std::vector<Instance> instances;
+  instances.push_back(Grid(60 * scale, 60, 1));
+  instances.push_back(Layered(12 * scale, 200, 4, 2));
+  instances.push_back(Bipartite(3000 * scale, 3, 3));
+
+  const char* rule_names[3] = {"highest_label", "fifo", "lifo"};
+  const int rules[3] = {CMAXFLOW_HIGHEST_LABEL, CMAXFLOW_FIFO, CMAXFLOW_LIFO};
+  int status = 0;
+  for (size_t k = 0; k < instances.size(); k++) {
+    const Instance& g = instances[k];
+    for (int r = 0; r < 3; r++) {
+      for (int it = 0; it < repeat; it++) {
+        cmaxflow_graph* solver = cmaxflow_new();
+        auto t0 = std::chrono::steady_clock::now();
+        if (!cmaxflow_build(solver, g.src.size(), g.src.data(), g.dst.data(),
+              g.capacity.data(), NULL, 0, 1)
+            || !cmaxflow_set_source_sink(solver, g.s, g.t)) {
+          std::fprintf(stderr, "failed to build %s\n", g.name.c_str());
+          cmaxflow_free(solver);
+          return 1;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double flow = cmaxflow_max_preflow(solver, 1, 1e-6, rules[r]);
+        auto t2 = std::chrono::steady_clock::now();
+        if (cmaxflow_status(solver) != CMAXFLOW_OPTIMAL) {
+          status = 1;
+        }
+        std::printf("%-10s %-14s edges %8zu  flow %12.1f  build %.3f s  solve %.3f s\n",
+          g.name.c_str(), rule_names[r], g.src.size(), flow,
+          std::chrono::duration<double>(t1 - t0).count(),
+          std::chrono::duration<double>(t2 - t1).count());
+        cmaxflow_free(solver);
+      }
+    }
+  }
+
+  // The global minimum cut should cost a small multiple of one max flow on
+  // the same graph; its time is printed next to the max-flow time.
+  Instance expander = Expander(20000 * scale, 4, 5);
+  for (int it = 0; it < repeat; it++) {
+    cmaxflow_graph* solver = cmaxflow_new();
+    if (!cmaxflow_build(solver, expander.src.size(), expander.src.data(),
+          expander.dst.data(), expander.capacity.data(), NULL, 0, 1)
+        || !cmaxflow_set_source_sink(solver, expander.s, expander.t)) {
+      std::fprintf(stderr, "failed to build %s\n", expander.name.c_str());
+      cmaxflow_free(solver);
+      return 1;
+    }
+    size_t n = cmaxflow_node_number(solver);
+    std::vector<int> names(n);
+    std::vector<char> side(n);
+    double value = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    cmaxflow_max_preflow(solver, 1, 1e-6, CMAXFLOW_HIGHEST_LABEL);
+    auto t1 = std::chrono::steady_clock::now();
+    if (!cmaxflow_global_min_cut(solver, 1e-6, &value, names.data(), side.data())) {
+      status = 1;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    std::printf("%-10s %-14s edges %8zu  cut %13.1f  maxflow %.3f s  solve %.3f s\n",
+      expander.name.c_str(), "global_cut", expander.src.size(), value,
+      std::chrono::duration<double>(t1 - t0).count(),
+      std::chrono::duration<double>(t2 - t1).count());
+    cmaxflow_free(solver);
+  }
+
+  Batch batch = SmallGraphs(2000 * scale, 60, 4);
+  std::vector<double> flows(batch.sources.size());
+  std::vector<uint8_t> source_side(batch.node_offsets.back());
+  for (int it = 0; it < repeat; it++) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (!cmaxflow_solve_batch(batch.sources.size(), batch.node_offsets.data(),
+          batch.edge_offsets.data(), batch.src.data(), batch.dst.data(),
+          batch.capacity.data(), NULL, batch.sources.data(), batch.sinks.data(),
+          1e-6, 1, flows.data(), source_side.data())) {
+      std::fprintf(stderr, "failed to solve the batch\n");
+      return 1;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::printf("%-10s %-14s edges %8zu  graphs %zu  solve %.3f s\n", "batch", "fifo",
+      batch.src.size(), batch.sources.size(),
+      std::chrono::duration<double>(t1 - t0).count());
+  }
+  return status;
+}
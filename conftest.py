@@ -0,0 +1,69 @@
+"""
+Helpers of the pytest cases: random graphs and the NetworkX reference
+solutions the solver results are checked against.
+"""
+import random
+
+import networkx as nx
+import pytest
+
+
+def make_random_digraph(n, m, seed, max_capacity=20, integer=True):
+    """
+    DiGraph with about m random edges on the nodes 0 .. n-1 (no isolated
+    nodes, which the solver would not know about) and float capacities.
+    """
+    rng = random.Random(seed)
+    G = nx.DiGraph()
+    for _ in range(m):
+        u, v = rng.randrange(n), rng.randrange(n)
+        if u == v:
+            continue
+        c = rng.randint(1, max_capacity) if integer else rng.uniform(0.5, max_capacity)
+        G.add_edge(u, v, capacity=float(c))
+    return G
+
+
+def cut_capacity(G, S):
+    return sum(c for u, v, c in G.edges.data('capacity', default=0.0)
+               if u in S and v not in S)
+
+
+def reference_cuts(G, s, t):
+    """
+    Return (flow value, smallest source side, largest source side) of the
+    minimum s-t cuts of G, from the residual network of NetworkX.
+    """
+    R = nx.algorithms.flow.preflow_push(G, s, t)
+    value = R.graph['flow_value']
+    open_edges = [(u, v) for u, v, d in R.edges(data=True)
+                  if d['capacity'] - d['flow'] > 1e-9]
+    residual = nx.DiGraph(open_edges)
+    residual.add_nodes_from(G)
+    minimal = nx.descendants(residual, s) | {s}
+    maximal = set(G) - nx.ancestors(residual, t) - {t}
+    return value, minimal, maximal
+
+
+@pytest.fixture
+def random_digraph():
+    return make_random_digraph
+
+
+@pytest.fixture
+def check_min_cut():
+    """
+    Check a (value, (S, T)) result of min_cut() against NetworkX: the flow
+    value, a partition of the nodes with s in S and t in T, the capacity of
+    the cut, and the exact sets when minimal is given.
+    """
+    def check(G, s, t, result, minimal=None):
+        value, (S, T) = result
+        expected, smallest, largest = reference_cuts(G, s, t)
+        assert value == pytest.approx(expected)
+        assert S | T == set(G) and not S & T
+        assert s in S and t in T
+        assert cut_capacity(G, S) == pytest.approx(expected)
+        if minimal is not None:
+            assert S == (smallest if minimal else largest)
+    return check
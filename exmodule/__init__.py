@@ -1,7 +1,11 @@
-from .graph import digraph_to_edge_list, CythonGraph, CythonMaxflowGraph
+from .graph import digraph_to_edge_list, CythonGraph, CythonMaxflowGraph, \
+    CythonUnitMaxflowGraph, unlink_shared, solve_batch
 
 __all__ = [
     'digraph_to_edge_list',
     'CythonGraph',
-    'CythonMaxflowGraph'
+    'CythonMaxflowGraph',
+    'CythonUnitMaxflowGraph',
+    'unlink_shared',
+    'solve_batch'
 ]
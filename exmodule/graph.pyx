@@ -1,18 +1,41 @@
 import networkx as nx
+import numpy as np
+cimport numpy as cnp
+from libcpp.string cimport string
+from libcpp.vector cimport vector
+from libcpp.pair cimport pair
+from libc.stdint cimport int64_t, uint8_t
 
+cnp.import_array()
 
-def digraph_to_edge_list(g, capacity = 'capacity'):
+
+def digraph_to_edge_list(g, capacity = 'capacity', fold_reverse = False):
     """
-    Convert a NetworkX DiGraph object into an edge list that is acceptable to
+    Convert a NetworkX graph object into an edge list that is acceptable to
     CythonGraph.from_py_object
+
+    An undirected graph (nx.Graph) gives one edge per undirected edge, with
+    the same capacity in both directions ('reverse_capacity').
+    For a DiGraph with fold_reverse=True, the edges (u, v) and (v, u) are
+    given as one edge with capacity and reverse_capacity, so that they share
+    one edge pair in the solver.
     """
+    out = []
     if not nx.is_directed(g):
-        raise ValueError("Input graph is not a DiGraph object")
+        for (src, dst, data) in g.edges.data():
+            cap = float(data.get(capacity, 0.0))
+            out.append((src, dst, {'capacity': cap, 'reverse_capacity': cap}))
+        return out
 
-    out = []
     for (src, dst, data) in g.edges.data():
-        cap = data.get(capacity, 0.0)
-        out.append((src, dst, {'capacity': cap}))
+        cap = float(data.get(capacity, 0.0))
+        if fold_reverse and g.has_edge(dst, src) and src != dst:
+            if (src, dst) > (dst, src):
+                continue
+            rev_cap = float(g[dst][src].get(capacity, 0.0))
+            out.append((src, dst, {'capacity': cap, 'reverse_capacity': rev_cap}))
+        else:
+            out.append((src, dst, {'capacity': cap}))
 
     return out
 
@@ -22,7 +45,8 @@ cdef extern from "src/graph.h" namespace "cmaxflow":
         GraphDouble()
         GraphDouble(int max_node_num)
         void Reset()
-        int FromPyObject(object edge_list, int check_edge_redundancy)
+        int FromPyObject(object edge_list, int check_edge_redundancy,
+                         unsigned int num_threads) except? 0
         int GetNodeNumber()
         int GetEdgeNumber()
         str ToPythonString()
@@ -37,8 +61,14 @@ cdef class CythonGraph:
     def __dealloc__(self):
         del self.thisptr
 
-    def from_py_object(self, object edge_list):
-        self.thisptr.FromPyObject(edge_list, 0)
+    def from_py_object(self, object edge_list, unsigned int num_threads = 0):
+        """
+        Build the graph from an edge list. The adjacency is built in parallel
+        on num_threads threads (0, the default, uses all cores). Raise
+        ValueError for a malformed edge list.
+        """
+        if not self.thisptr.FromPyObject(edge_list, 0, num_threads):
+            raise ValueError("Failed to build the graph from the edge list")
 
     def get_node_number(self):
         return self.thisptr.GetNodeNumber()
@@ -50,40 +80,458 @@ cdef class CythonGraph:
         return self.thisptr.ToPythonString()
 
 
+cdef extern from "src/shared.h" namespace "cmaxflow":
+    cdef cppclass SharedSegment:
+        @staticmethod
+        bint Unlink(string name)
+
+
+def unlink_shared(str name):
+    """
+    Remove a shared-memory graph created by CythonMaxflowGraph.export_shared.
+    Attached processes keep their mappings until they rebuild or exit.
+    """
+    return SharedSegment.Unlink(name.encode())
+
+
+cdef extern from "src/graph.h" namespace "cmaxflow":
+    cdef cppclass EdgeDouble "cmaxflow::Edge<double>":
+        size_t src
+        size_t dst
+        double capacity
+        size_t reversed
+
+
+cdef extern from "src/memory.h" namespace "cmaxflow":
+    cdef struct AllocationReport:
+        int pages
+        int numa
+        size_t large_bytes
+
 cdef extern from "src/maxflow.h" namespace "cmaxflow":
     cdef cppclass MaxflowGraphDouble:
         MaxflowGraphDouble()
         MaxflowGraphDouble(int max_node_num)
 
-        int FromPyObject(object edge_list, int check_edge_redundancy)
+        int FromPyObject(object edge_list, int check_edge_redundancy,
+                         unsigned int num_threads) except? 0
+        int FromPyObject(object edge_list, vector[pair[int, double]] node_capacities,
+                         int check_edge_redundancy, unsigned int num_threads) except? 0
         int SetSourceSink(int s, int t)
-        float MaxPreFlow(int global_relabel_frequency, float tol)
+        int ExportShared(const char* name)
+        int AttachShared(const char* name)
+        int SetAllocationPolicy(int pages, int numa, unsigned int num_threads)
+        AllocationReport GetAllocationReport()
+        int ReorderNodes(int method, unsigned int num_threads)
+        float MaxPreFlow(int global_relabel_frequency, float tol, int selection)
         void MinCut()
+        int BipartiteMatching(double tol)
+        object ToPythonMatching()
+        void SetFlowThreshold(double flow_threshold)
+        void SetBudget(double time_limit, unsigned long long work_limit)
+        void SetNumThreads(unsigned int num_threads)
+        int GetStatus()
+        double GetUpperBound()
+        void EnableTrace(size_t capacity)
+        void DisableTrace()
+        str ToPythonTrace()
+        size_t GetNodeNumber()
+        size_t GetEdgeNumber()
+        int GetNodeName(size_t index)
+        int GetOriginalName(size_t index)
+        bint IsOutCopy(size_t index)
+        const size_t* GetOffsets()
+        const EdgeDouble* GetEdges()
+        void GetResiduals(double* residuals)
+        void SourceSideMinCut()
         object ToPythonMinCut()
+        object ToPythonMinCut(bint minimal_source_side)
+        object ToPythonCutNodes()
+        int GlobalMinCut(double tol)
+        object ToPythonGlobalMinCut()
+
+
+_REORDER_METHODS = {'none': 0, 'bfs': 1, 'rcm': 2, 'degree': 3}
+_SELECTION_RULES = {'highest_label': 0, 'fifo': 1, 'lifo': 2}
+_PAGE_POLICIES = {'default': 0, 'transparent': 1, 'explicit': 2}
+_NUMA_POLICIES = {'none': 0, 'first_touch': 1, 'interleave': 2}
+_SOLVE_STATUS = ['optimal', 'threshold_reached', 'threshold_unreachable',
+                 'time_limit', 'work_limit']
 
 
 cdef class CythonMaxflowGraph:
     cdef MaxflowGraphDouble* thisptr
     cdef int done_maxflow
+    cdef double flow_value
 
     def __cinit__(self, int max_node_num = 128):
         self.done_maxflow = False
+        self.flow_value = 0.0
         self.thisptr = new MaxflowGraphDouble(max_node_num)
 
     def __dealloc__(self):
         del self.thisptr
 
+    def from_py_object(self, object edge_list, int s, int t, unsigned int num_threads = 0,
+                       object node_capacities = None):
+        """
+        The adjacency is built on num_threads threads (0, the default, uses
+        all cores). node_capacities is an optional dict {node: capacity} of
+        nodes that can pass a limited amount of flow (capacities of s and t
+        are not used).
+        """
+        cdef vector[pair[int, double]] c_node_capacities
+        cdef bint ok
+        self.done_maxflow = False
+        if node_capacities:
+            c_node_capacities = [(v, float(c)) for v, c in node_capacities.items()]
+            ok = self.thisptr.FromPyObject(edge_list, c_node_capacities, 0, num_threads)
+        else:
+            ok = self.thisptr.FromPyObject(edge_list, 0, num_threads)
+        if not ok:
+            raise ValueError("Failed to build the graph from the edge list")
+        if not self.thisptr.SetSourceSink(s, t):
+            raise ValueError("Source %d or sink %d is not a node of the graph" % (s, t))
+
+    def set_allocation_policy(self, str pages = 'transparent', str numa = 'none',
+                              unsigned int num_threads = 0):
+        """
+        Placement of the node, edge and flow arrays of large graphs; call it
+        before from_py_object. pages is 'default', 'transparent' (huge pages
+        through madvise) or 'explicit' (reserved huge pages, falling back to
+        transparent ones). numa is 'none', 'first_touch' (pages touched by
+        num_threads threads pinned to CPUs, split like the parallel phases,
+        whose threads are then pinned the same way) or 'interleave'. Both
+        NUMA policies fall back to 'none' on a single NUMA node. See
+        allocation_report() for what took effect.
+        """
+        if pages not in _PAGE_POLICIES:
+            raise ValueError("Unknown page policy: %s" % pages)
+        if numa not in _NUMA_POLICIES:
+            raise ValueError("Unknown NUMA policy: %s" % numa)
+        self.done_maxflow = False
+        self.thisptr.SetAllocationPolicy(_PAGE_POLICIES[pages], _NUMA_POLICIES[numa],
+                                         num_threads)
+
+    def allocation_report(self):
+        """
+        Return {'pages': ..., 'numa': ..., 'large_bytes': ...}: the policies
+        in effect for all arrays of the current graph placed by the policy
+        (the weakest one if they differ), and the size of those arrays.
+        Arrays under 2 MiB use the default allocator.
+        """
+        cdef AllocationReport report = self.thisptr.GetAllocationReport()
+        page_names = {v: k for k, v in _PAGE_POLICIES.items()}
+        numa_names = {v: k for k, v in _NUMA_POLICIES.items()}
+        return {'pages': page_names[report.pages], 'numa': numa_names[report.numa],
+                'large_bytes': report.large_bytes}
+
+    def export_shared(self, str name):
+        """
+        Copy the graph to a new POSIX shared-memory object (e.g. '/my_graph')
+        so that other processes can attach to it without rebuilding.
+        """
+        cdef bytes b_name = name.encode()
+        if not self.thisptr.ExportShared(b_name):
+            raise OSError("Failed to export the graph to shared memory %s" % name)
+
+    def attach_shared(self, str name, int s, int t):
+        """
+        Use a graph exported by export_shared. Edges and capacities are read
+        from shared memory; only flows and node states are allocated here.
+        Raise OSError if the segment cannot be opened or does not hold a
+        valid graph of this type.
+        """
+        cdef bytes b_name = name.encode()
+        if not self.thisptr.AttachShared(b_name):
+            raise OSError("Failed to attach to shared memory %s" % name)
+        self.done_maxflow = False
+        if not self.thisptr.SetSourceSink(s, t):
+            raise ValueError("Source %d or sink %d is not a node of the graph" % (s, t))
+
+    def reorder_nodes(self, str method = 'bfs', unsigned int num_threads = 1):
+        """
+        Renumber nodes before solving to improve memory locality.
+        method is one of 'none', 'bfs' (from the sink), 'rcm' or 'degree'.
+        Raise ValueError if the graph has no distinct source and sink yet.
+        """
+        if method not in _REORDER_METHODS:
+            raise ValueError("Unknown reorder method: %s" % method)
+        self.done_maxflow = False
+        if not self.thisptr.ReorderNodes(_REORDER_METHODS[method], num_threads):
+            raise ValueError("reorder_nodes needs a graph with a source and a sink")
+
+    def max_preflow(self, int global_relabel_frequency=1, float tol=1e-6,
+                    str selection='highest_label', double flow_threshold=0.0,
+                    double time_limit=0.0, unsigned long long work_limit=0,
+                    unsigned int num_threads=1):
+        """
+        Compute a maximum preflow. selection is the active-node rule:
+        'highest_label', 'fifo' or 'lifo'.
+
+        If flow_threshold > 0, stop as soon as the flow value is known to be
+        at least / below it. time_limit (seconds) and work_limit (edge scans)
+        bound the running time. After an early exit the return value is a
+        lower bound and min_cut() returns the best cut found so far;
+        see status().
+
+        num_threads is used by the breadth-first searches of the global
+        relabeling and of min_cut() (0 = all hardware threads).
+        """
+        if selection not in _SELECTION_RULES:
+            raise ValueError("Unknown selection rule: %s" % selection)
+        self.thisptr.SetFlowThreshold(flow_threshold)
+        self.thisptr.SetBudget(time_limit, work_limit)
+        self.thisptr.SetNumThreads(num_threads)
+        self.done_maxflow = True
+        self.flow_value = self.thisptr.MaxPreFlow(global_relabel_frequency, tol,
+                                                  _SELECTION_RULES[selection])
+        return self.flow_value
+
+    def bipartite_matching(self, double tol=1e-6):
+        """
+        Solve a unit-capacity bipartite matching graph (s -> U -> V -> t) by
+        Hopcroft-Karp instead of push-relabel. Return the matched (u, v)
+        pairs and the min_cut() result. Raise ValueError if the graph does
+        not have this form; max_preflow handles any graph.
+        """
+        if not self.thisptr.BipartiteMatching(tol):
+            self.done_maxflow = False
+            raise ValueError("The graph is not a unit-capacity bipartite matching graph")
+        self.done_maxflow = True
+        self.flow_value = self.thisptr.GetUpperBound()
+        matching = self.thisptr.ToPythonMatching()
+        self.thisptr.MinCut()
+        return matching, self.thisptr.ToPythonMinCut()
+
+    def status(self):
+        """
+        Status of the last max_preflow call with lower and upper bounds of
+        the maximum flow value.
+        """
+        if not self.done_maxflow:
+            return None
+        return {
+            'status': _SOLVE_STATUS[self.thisptr.GetStatus()],
+            'lower_bound': self.flow_value,
+            'upper_bound': self.thisptr.GetUpperBound()
+        }
+
+    def enable_trace(self, size_t capacity = 65536):
+        """
+        Record the build and solver phases (build, bucket initialization,
+        global relabelings, gap heuristics, discharge streaks, min cut) in a
+        ring buffer of the given number of spans.
+        """
+        self.thisptr.EnableTrace(capacity)
+
+    def disable_trace(self):
+        self.thisptr.DisableTrace()
+
+    def trace_json(self):
+        """
+        Return the recorded spans in the Chrome trace-event JSON format.
+        """
+        return self.thisptr.ToPythonTrace()
+
+    def min_cut(self, bint minimal = False):
+        """
+        Return (flow value, (S, T)) for a minimum cut. By default S is the
+        largest source side (T = nodes that can reach the sink in the
+        residual graph); minimal=True gives the smallest source side
+        (S = nodes reachable from the source in the residual graph of a
+        maximum flow).
+        """
+        if not self.done_maxflow:
+            self.max_preflow()
+
+        if minimal:
+            self.thisptr.SourceSideMinCut()
+        else:
+            self.thisptr.MinCut()
+        return self.thisptr.ToPythonMinCut(minimal)
+
+    def residual_graph(self):
+        """
+        Return the residual graph of the last solve as CSR NumPy arrays
+        (names, offsets, dst, residual, out_copy): the edges out of the node
+        names[i] are offsets[i] <= e < offsets[i + 1], going to node index
+        dst[e] with residual capacity residual[e]. Each edge has a reversed
+        edge. A node with a capacity has two rows with its name: the one with
+        out_copy[i] set holds its out-edges, the other its in-edges.
+
+        All arrays are copies, so they stay valid when the graph is rebuilt,
+        reordered or detached from shared memory.
+        """
+        cdef size_t n = self.thisptr.GetNodeNumber()
+        cdef size_t m = self.thisptr.GetEdgeNumber()
+        cdef size_t i
+        cdef const size_t* c_offsets = self.thisptr.GetOffsets()
+        cdef const EdgeDouble* c_edges = self.thisptr.GetEdges()
+        cdef cnp.ndarray[cnp.int64_t] names = np.empty(n, dtype=np.int64)
+        cdef cnp.ndarray[cnp.uintp_t] offsets = np.empty(n + 1, dtype=np.uintp)
+        cdef cnp.ndarray[cnp.uintp_t] dst = np.empty(m, dtype=np.uintp)
+        cdef cnp.ndarray[cnp.float64_t] residual = np.empty(m, dtype=np.float64)
+        cdef cnp.ndarray[cnp.uint8_t, cast=True] out_copy = np.empty(n, dtype=np.bool_)
+
+        for i in range(n):
+            names[i] = self.thisptr.GetOriginalName(i)
+            out_copy[i] = self.thisptr.IsOutCopy(i)
+        for i in range(n + 1):
+            offsets[i] = c_offsets[i]
+        for i in range(m):
+            dst[i] = c_edges[i].dst
+        if m > 0:
+            self.thisptr.GetResiduals(&residual[0])
+        return names, offsets, dst, residual, out_copy
+
+    def cut_nodes(self):
+        """
+        Return the set of nodes whose capacity is in the minimum cut
+        (graphs built with node_capacities). Call after min_cut().
+        """
+        return self.thisptr.ToPythonCutNodes()
+
+    def global_min_cut(self, double tol=1e-6, unsigned int num_threads=1):
+        """
+        Return (cut value, (S, T)) for a global minimum cut: the smallest
+        capacity of the edges from S to T over all partitions of the nodes,
+        ignoring s and t. Runs Hao-Orlin on the push-relabel machinery
+        (two runs, each within the time bound of one max flow, instead of
+        2(n - 1) max_preflow calls), and discards the flows of max_preflow.
+        num_threads is used by the global relabelings (0 = all hardware
+        threads). Raise ValueError for graphs with node capacities or less
+        than two nodes.
+        """
+        self.done_maxflow = False
+        self.thisptr.SetNumThreads(num_threads)
+        if not self.thisptr.GlobalMinCut(tol):
+            raise ValueError("The global minimum cut needs at least two nodes and no node capacities")
+        return self.thisptr.ToPythonGlobalMinCut()
+
+
+cdef extern from "src/unitflow.h" namespace "cmaxflow":
+    cdef cppclass UnitMaxflowGraph:
+        UnitMaxflowGraph()
+        int FromPyObject(object edge_list) except? 0
+        int SetSourceSink(int s, int t)
+        int GetNodeNumber()
+        int GetEdgeNumber()
+        double MaxFlow()
+        void MinCut()
+        object ToPythonMinCut()
+
+
+cdef class CythonUnitMaxflowGraph:
+    """
+    Maximum flow for graphs whose capacities are all 0 or 1 (edge
+    connectivity, edge-disjoint paths). Residual capacities are stored as
+    bits and the flow is found by Dinic's algorithm.
+    """
+    cdef UnitMaxflowGraph* thisptr
+    cdef int done_maxflow
+
+    def __cinit__(self):
+        self.done_maxflow = False
+        self.thisptr = new UnitMaxflowGraph()
+
+    def __dealloc__(self):
+        del self.thisptr
+
     def from_py_object(self, object edge_list, int s, int t):
-        self.thisptr.FromPyObject(edge_list, 0)
-        self.thisptr.SetSourceSink(s, t)
+        """
+        Build the graph from the same edge list as CythonMaxflowGraph.
+        Raise ValueError if a capacity is not 0 or 1, or if s or t is not
+        a node of the graph.
+        """
+        self.done_maxflow = False
+        if not self.thisptr.FromPyObject(edge_list):
+            raise ValueError("Failed to build the graph from the edge list")
+        if not self.thisptr.SetSourceSink(s, t):
+            raise ValueError("Source %d or sink %d is not a node of the graph" % (s, t))
+
+    def get_node_number(self):
+        return self.thisptr.GetNodeNumber()
+
+    def get_edge_number(self):
+        return self.thisptr.GetEdgeNumber()
 
-    def max_preflow(self, int global_relabel_frequency=1, float tol=1e-6):
+    def max_flow(self):
         self.done_maxflow = True
-        return self.thisptr.MaxPreFlow(global_relabel_frequency, tol)
+        return self.thisptr.MaxFlow()
 
     def min_cut(self):
         if not self.done_maxflow:
-            self.max_preflow()
+            self.max_flow()
 
         self.thisptr.MinCut()
         return self.thisptr.ToPythonMinCut()
+
+
+cdef extern from "src/batch.h" namespace "cmaxflow":
+    bint SolveBatch "cmaxflow::SolveBatch<double>"(
+        size_t graph_number, const int64_t* node_offsets, const int64_t* edge_offsets,
+        const int* src, const int* dst, const double* capacity,
+        const double* reverse_capacity, const int* sources, const int* sinks,
+        double tol, unsigned int num_threads, double* flows, uint8_t* source_side) nogil
+
+
+def solve_batch(node_offsets, edge_offsets, src, dst, capacity, sources, sinks,
+                reverse_capacity = None, double tol = 1e-6, unsigned int num_threads = 0):
+    """
+    Solve many small max-flow problems in one call.
+
+    Graph g has the nodes 0 .. node_offsets[g + 1] - node_offsets[g] - 1,
+    the edges k in [edge_offsets[g], edge_offsets[g + 1]) from src[k] to
+    dst[k] with capacity[k] (and reverse_capacity[k] from dst[k] to src[k]),
+    the source sources[g] and the sink sinks[g].
+
+    Return (flows, source_side): the flow value of each graph, and a bool
+    array where source_side[node_offsets[g] + v] tells whether node v of
+    graph g is on the source side of its minimum cut.
+    num_threads = 0 uses all hardware threads.
+    """
+    cdef cnp.ndarray c_node_offsets = np.ascontiguousarray(node_offsets, dtype=np.int64)
+    cdef cnp.ndarray c_edge_offsets = np.ascontiguousarray(edge_offsets, dtype=np.int64)
+    cdef cnp.ndarray c_src = np.ascontiguousarray(src, dtype=np.intc)
+    cdef cnp.ndarray c_dst = np.ascontiguousarray(dst, dtype=np.intc)
+    cdef cnp.ndarray c_capacity = np.ascontiguousarray(capacity, dtype=np.float64)
+    cdef cnp.ndarray c_sources = np.ascontiguousarray(sources, dtype=np.intc)
+    cdef cnp.ndarray c_sinks = np.ascontiguousarray(sinks, dtype=np.intc)
+    cdef cnp.ndarray c_reverse_capacity = None
+    cdef const double* reverse_capacity_ptr = NULL
+    cdef Py_ssize_t graph_number = c_sources.shape[0]
+    if (c_node_offsets.ndim != 1 or c_edge_offsets.ndim != 1
+            or c_node_offsets.shape[0] != graph_number + 1
+            or c_edge_offsets.shape[0] != graph_number + 1 or c_sinks.shape[0] != graph_number):
+        raise ValueError("node_offsets and edge_offsets need len(sources) + 1 entries "
+                         "and sinks len(sources) entries")
+    cdef Py_ssize_t edge_number = c_edge_offsets[graph_number] if graph_number > 0 else 0
+    if (c_src.shape[0] < edge_number or c_dst.shape[0] < edge_number
+            or c_capacity.shape[0] < edge_number):
+        raise ValueError("src, dst and capacity need edge_offsets[-1] entries")
+    if reverse_capacity is not None:
+        c_reverse_capacity = np.ascontiguousarray(reverse_capacity, dtype=np.float64)
+        if c_reverse_capacity.shape[0] < edge_number:
+            raise ValueError("reverse_capacity needs edge_offsets[-1] entries")
+        reverse_capacity_ptr = <const double*> cnp.PyArray_DATA(c_reverse_capacity)
+    cdef Py_ssize_t node_number = c_node_offsets[graph_number] if graph_number > 0 else 0
+    cdef cnp.ndarray flows = np.zeros(graph_number, dtype=np.float64)
+    cdef cnp.ndarray source_side = np.zeros(node_number, dtype=np.uint8)
+    cdef bint ok
+    with nogil:
+        ok = SolveBatch(<size_t> graph_number,
+                        <const int64_t*> cnp.PyArray_DATA(c_node_offsets),
+                        <const int64_t*> cnp.PyArray_DATA(c_edge_offsets),
+                        <const int*> cnp.PyArray_DATA(c_src),
+                        <const int*> cnp.PyArray_DATA(c_dst),
+                        <const double*> cnp.PyArray_DATA(c_capacity),
+                        reverse_capacity_ptr,
+                        <const int*> cnp.PyArray_DATA(c_sources),
+                        <const int*> cnp.PyArray_DATA(c_sinks),
+                        tol, num_threads,
+                        <double*> cnp.PyArray_DATA(flows),
+                        <uint8_t*> cnp.PyArray_DATA(source_side))
+    if not ok:
+        raise ValueError("Malformed batch (see the warning above)")
+    return flows, source_side.view(np.bool_)
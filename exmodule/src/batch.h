@@ -0,0 +1,256 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+
+#include "parallel.h"
+#include "utils.h"
+
+// Batch solver for many small max-flow problems (tens to hundreds of nodes).
+// For such graphs the cost of MaxflowGraph is mostly setup: the name map,
+// n buckets and per-graph allocations. Here every thread reuses one flat
+// workspace (CSR arrays, residuals, heights and a FIFO queue), and threads
+// take graphs from a shared counter.
+//
+// The batch is given as packed arrays. Graph g has the nodes
+// 0 .. node_offsets[g + 1] - node_offsets[g] - 1 and the edges
+// k in [edge_offsets[g], edge_offsets[g + 1]) from src[k] to dst[k] with
+// capacity[k], and reverse_capacity[k] from dst[k] to src[k] (zero if
+// reverse_capacity is null). Its flow value goes to flows[g], and
+// source_side[node_offsets[g] + v] is 1 if node v is on the source side of
+// the minimum cut (the nodes that cannot reach the sink in the residual
+// graph, as in MaxflowGraph::MinCut), 0 otherwise.
+
+namespace cmaxflow {
+
+template <typename FlowType>
+class BatchWorkspace {
+public:
+  // Solve one graph; src, dst and capacities point to its first edge.
+  FlowType Solve(int n, size_t m, const int* src, const int* dst,
+    const FlowType* capacity, const FlowType* reverse_capacity, int s, int t,
+    FlowType tol, uint8_t* source_side);
+
+private:
+  std::vector<int> offsets_;
+  std::vector<int> head_;
+  std::vector<int> reversed_;
+  std::vector<FlowType> residual_;
+  std::vector<FlowType> excess_;
+  std::vector<int> height_;
+  std::vector<int> current_;
+  std::vector<int> queue_;
+  std::vector<char> queued_;
+  std::vector<int> bfs_;
+
+  FlowType tol_;
+  bool Open(int arc) { return residual_[arc] > 0 && !isclose<FlowType>(residual_[arc], 0, tol_); }
+  bool HasExcess(int v) { return excess_[v] > 0 && !isclose<FlowType>(excess_[v], 0, tol_); }
+
+  void Build(int n, size_t m, const int* src, const int* dst,
+    const FlowType* capacity, const FlowType* reverse_capacity);
+  // Exact distances to the sink in the residual graph (n if unreachable).
+  void GlobalRelabeling(int n, int s, int t);
+};
+
+template <typename FlowType>
+void BatchWorkspace<FlowType>::Build(int n, size_t m, const int* src, const int* dst,
+  const FlowType* capacity, const FlowType* reverse_capacity) {
+  offsets_.assign(n + 1, 0);
+  for (size_t k = 0; k < m; k++) {
+    offsets_[src[k] + 1] += 1;
+    offsets_[dst[k] + 1] += 1;
+  }
+  for (int v = 0; v < n; v++) {
+    offsets_[v + 1] += offsets_[v];
+  }
+  head_.resize(2 * m);
+  reversed_.resize(2 * m);
+  residual_.resize(2 * m);
+  current_.assign(offsets_.begin(), offsets_.end() - 1);
+  for (size_t k = 0; k < m; k++) {
+    int arc = current_[src[k]]++;
+    int arc_rev = current_[dst[k]]++;
+    head_[arc] = dst[k];
+    head_[arc_rev] = src[k];
+    reversed_[arc] = arc_rev;
+    reversed_[arc_rev] = arc;
+    residual_[arc] = capacity[k];
+    residual_[arc_rev] = reverse_capacity == nullptr ? 0 : reverse_capacity[k];
+  }
+}
+
+template <typename FlowType>
+void BatchWorkspace<FlowType>::GlobalRelabeling(int n, int s, int t) {
+  height_.assign(n, n);
+  height_[t] = 0;
+  bfs_[0] = t;
+  int end = 1;
+  for (int begin = 0; begin < end; begin++) {
+    int v = bfs_[begin];
+    for (int arc = offsets_[v]; arc < offsets_[v + 1]; arc++) {
+      int u = head_[arc];
+      if (height_[u] == n && u != s && Open(reversed_[arc])) {
+        height_[u] = height_[v] + 1;
+        bfs_[end++] = u;
+      }
+    }
+  }
+  for (int v = 0; v < n; v++) {
+    current_[v] = offsets_[v];
+  }
+}
+
+template <typename FlowType>
+FlowType BatchWorkspace<FlowType>::Solve(int n, size_t m, const int* src, const int* dst,
+  const FlowType* capacity, const FlowType* reverse_capacity, int s, int t,
+  FlowType tol, uint8_t* source_side) {
+  tol_ = tol;
+  Build(n, m, src, dst, capacity, reverse_capacity);
+  excess_.assign(n, 0);
+  current_.resize(n);
+  queue_.resize(n);
+  queued_.assign(n, 0);
+  bfs_.resize(n);
+  GlobalRelabeling(n, s, t);
+
+  // FIFO queue of active nodes (each node at most once), as a ring buffer
+  int first = 0;
+  int size = 0;
+  auto push = [&](int arc, FlowType amount) {
+    int v = head_[arc];
+    residual_[arc] -= amount;
+    residual_[reversed_[arc]] += amount;
+    excess_[v] += amount;
+    if (v != s && v != t && !queued_[v] && height_[v] < n) {
+      queued_[v] = 1;
+      queue_[(first + size) % n] = v;
+      size += 1;
+    }
+  };
+  for (int arc = offsets_[s]; arc < offsets_[s + 1]; arc++) {
+    if (Open(arc)) {
+      FlowType amount = residual_[arc];
+      excess_[s] -= amount;
+      push(arc, amount);
+    }
+  }
+
+  int relabels = 0;
+  while (size > 0) {
+    int v = queue_[first];
+    first = (first + 1) % n;
+    size -= 1;
+    queued_[v] = 0;
+    // Discharge v
+    while (height_[v] < n && HasExcess(v)) {
+      if (current_[v] == offsets_[v + 1]) {
+        int min_height = n;
+        for (int arc = offsets_[v]; arc < offsets_[v + 1]; arc++) {
+          if (Open(arc)) {
+            min_height = std::min(min_height, height_[head_[arc]]);
+          }
+        }
+        height_[v] = std::min(min_height + 1, n);
+        current_[v] = offsets_[v];
+        relabels += 1;
+        continue;
+      }
+      int arc = current_[v];
+      if (Open(arc) && height_[v] == height_[head_[arc]] + 1) {
+        FlowType amount = std::min(excess_[v], residual_[arc]);
+        excess_[v] -= amount;
+        push(arc, amount);
+      }
+      else {
+        current_[v] += 1;
+      }
+    }
+    if (relabels >= n) {
+      // Active nodes keep their place in the queue; those lifted to n are
+      // skipped when they come up.
+      GlobalRelabeling(n, s, t);
+      relabels = 0;
+    }
+  }
+
+  // Sink side: nodes that can reach the sink in the residual graph
+  GlobalRelabeling(n, s, t);
+  for (int v = 0; v < n; v++) {
+    source_side[v] = (height_[v] == n && v != t) ? 1 : 0;
+  }
+  return excess_[t];
+}
+
+// Solve the graphs of a packed batch (see above); num_threads = 0 uses all
+// hardware threads. Returns false (and solves nothing) if the batch is
+// malformed.
+template <typename FlowType>
+bool SolveBatch(size_t graph_number, const int64_t* node_offsets, const int64_t* edge_offsets,
+  const int* src, const int* dst, const FlowType* capacity, const FlowType* reverse_capacity,
+  const int* sources, const int* sinks, FlowType tol, unsigned int num_threads,
+  FlowType* flows, uint8_t* source_side) {
+  for (size_t g = 0; g < graph_number; g++) {
+    int64_t n = node_offsets[g + 1] - node_offsets[g];
+    int64_t m = edge_offsets[g + 1] - edge_offsets[g];
+    if (n < 2 || n > std::numeric_limits<int>::max() || m < 0
+        || m > std::numeric_limits<int>::max() / 2 || node_offsets[g] < 0 || edge_offsets[g] < 0) {
+      std::cerr << "Warning: graph " << g << " of the batch has bad offsets." << std::endl;
+      return false;
+    }
+    if (sources[g] < 0 || sources[g] >= n || sinks[g] < 0 || sinks[g] >= n
+        || sources[g] == sinks[g]) {
+      std::cerr << "Warning: graph " << g << " of the batch has a bad source or sink." << std::endl;
+      return false;
+    }
+    for (int64_t k = edge_offsets[g]; k < edge_offsets[g + 1]; k++) {
+      if (src[k] < 0 || src[k] >= n || dst[k] < 0 || dst[k] >= n) {
+        std::cerr << "Warning: edge " << k << " of the batch is out of its graph." << std::endl;
+        return false;
+      }
+    }
+  }
+
+  // Threads take chunks of graphs, so that one large graph does not hold
+  // back a static share of the batch.
+  const size_t kChunk = 16;
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    BatchWorkspace<FlowType> workspace;
+    while (true) {
+      size_t begin = next.fetch_add(kChunk);
+      if (begin >= graph_number) {
+        break;
+      }
+      size_t end = std::min(begin + kChunk, graph_number);
+      for (size_t g = begin; g < end; g++) {
+        int64_t e = edge_offsets[g];
+        flows[g] = workspace.Solve((int) (node_offsets[g + 1] - node_offsets[g]),
+          (size_t) (edge_offsets[g + 1] - e), src + e, dst + e, capacity + e,
+          reverse_capacity == nullptr ? nullptr : reverse_capacity + e,
+          sources[g], sinks[g], tol, source_side + node_offsets[g]);
+      }
+    }
+  };
+  num_threads = ResolveThreadNumber(num_threads, (graph_number + kChunk - 1) / kChunk);
+  std::vector<std::thread> workers;
+  for (unsigned int k = 1; k < num_threads; k++) {
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+  for (auto it = workers.begin(); it != workers.end(); it++) {
+    it->join();
+  }
+  return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef _BFS_H
+#define _BFS_H
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+// Level-synchronous breadth-first search over the CSR edge array of a Graph,
+// used by the global relabeling and the min cut computations.
+//
+// Each level is expanded either top-down (scan the out-edges of the frontier)
+// or bottom-up (every unreached node scans its own out-edges for a frontier
+// node and stops at the first one), switching by the number of edges each
+// direction would scan (Beamer et al., direction-optimizing BFS). Levels are
+// exact in both directions. Large levels are split between the threads of a
+// ThreadPool; small graphs and levels run on the calling thread.
+
+namespace cmaxflow {
+
+template <typename FlowType>
+class FrontierBfs {
+public:
+  FrontierBfs() : size_(0) {}
+
+  // Search from roots (level 0). The search can go along an out-edge e of a
+  // reached node from edges[e].src to edges[e].dst if top_down_open(e), and
+  // bottom_up_open(e) must be equal to top_down_open(edges[e].reversed): it
+  // is asked for the out-edges of unreached nodes. num_threads = 0 uses all
+  // hardware threads of pool.
+  template <typename TopDownOpen, typename BottomUpOpen>
+  void Run(const size_t* offsets, const Edge<FlowType>* edges, size_t n,
+    const std::vector<size_t>& roots, unsigned int num_threads, ThreadPool* pool,
+    TopDownOpen top_down_open, BottomUpOpen bottom_up_open);
+
+  // Thread number for a pass over a graph with n nodes and m edges: 1 for
+  // small graphs, where starting threads costs more than it saves.
+  static unsigned int ThreadNumber(unsigned int num_threads, size_t n, size_t m) {
+    return n + m < kParallelGrain ? 1 : ResolveThreadNumber(num_threads, n);
+  }
+
+  // Level of the node with index v, or -1 if it was not reached.
+  int Level(size_t v) const { return levels_[v].load(std::memory_order_relaxed); }
+  // Reached nodes by level: the nodes of level d are
+  // Order()[LevelBegin(d) .. LevelBegin(d + 1)), sorted by index except the roots.
+  const std::vector<size_t>& Order() const { return order_; }
+  size_t LevelBegin(size_t d) const { return level_begin_[d]; }
+  size_t LevelNumber() const { return level_begin_.size() - 1; }
+
+private:
+  // Work below which a level (or the whole search) is not split
+  static const size_t kParallelGrain = 1 << 14;
+  // Switch to bottom-up when the frontier has more than 1/kAlpha of the
+  // unscanned edges, and back when it has less than 1/kBeta of the nodes.
+  static const size_t kAlpha = 14;
+  static const size_t kBeta = 24;
+
+  std::unique_ptr<std::atomic<int>[]> levels_;
+  size_t size_;
+  std::vector<size_t> order_;
+  std::vector<size_t> level_begin_;
+  std::vector<std::vector<size_t>> thread_nodes_;
+  std::vector<size_t> thread_edges_;
+
+  // Append the nodes found by each thread, in thread order, and return the
+  // number of their out-edges.
+  size_t Gather(unsigned int num_threads);
+};
+
+template <typename FlowType>
+size_t FrontierBfs<FlowType>::Gather(unsigned int num_threads) {
+  size_t frontier_edges = 0;
+  for (unsigned int k = 0; k < num_threads; k++) {
+    order_.insert(order_.end(), thread_nodes_[k].begin(), thread_nodes_[k].end());
+    frontier_edges += thread_edges_[k];
+  }
+  return frontier_edges;
+}
+
+template <typename FlowType>
+template <typename TopDownOpen, typename BottomUpOpen>
+void FrontierBfs<FlowType>::Run(const size_t* offsets, const Edge<FlowType>* edges, size_t n,
+  const std::vector<size_t>& roots, unsigned int num_threads, ThreadPool* pool,
+  TopDownOpen top_down_open, BottomUpOpen bottom_up_open) {
+  size_t m = offsets[n];
+  num_threads = ThreadNumber(num_threads, n, m);
+  if (size_ < n) {
+    levels_.reset(new std::atomic<int>[n]);
+    size_ = n;
+  }
+  pool->For(n, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      levels_[v].store(-1, std::memory_order_relaxed);
+    }
+  });
+  thread_nodes_.resize(num_threads);
+  thread_edges_.assign(num_threads, 0);
+  order_.clear();
+  order_.reserve(n);
+  level_begin_.assign(1, 0);
+
+  // Out-edges of the unreached nodes, and of the current frontier
+  size_t unscanned_edges = m;
+  size_t frontier_edges = 0;
+  for (size_t k = 0; k < roots.size(); k++) {
+    size_t v = roots[k];
+    if (Level(v) < 0) {
+      levels_[v].store(0, std::memory_order_relaxed);
+      order_.push_back(v);
+      frontier_edges += offsets[v + 1] - offsets[v];
+    }
+  }
+  level_begin_.push_back(order_.size());
+  unscanned_edges -= frontier_edges;
+
+  bool bottom_up = false;
+  for (int level = 0; ; level++) {
+    size_t begin = level_begin_[level];
+    size_t frontier_size = order_.size() - begin;
+    if (frontier_size == 0) {
+      level_begin_.pop_back();
+      break;
+    }
+    if (!bottom_up && frontier_edges > unscanned_edges / kAlpha) {
+      bottom_up = true;
+    }
+    else if (bottom_up && frontier_size < n / kBeta) {
+      bottom_up = false;
+    }
+    int next_level = level + 1;
+
+    if (bottom_up) {
+      unsigned int threads = n < kParallelGrain ? 1 : num_threads;
+      pool->For(n, threads, [&](unsigned int k, size_t first, size_t last) {
+        std::vector<size_t>& found = thread_nodes_[k];
+        found.clear();
+        size_t found_edges = 0;
+        for (size_t v = first; v < last; v++) {
+          if (Level(v) >= 0) {
+            continue;
+          }
+          for (size_t e = offsets[v]; e < offsets[v + 1]; e++) {
+            if (Level(edges[e].dst) == level && bottom_up_open(e)) {
+              levels_[v].store(next_level, std::memory_order_relaxed);
+              found.push_back(v);
+              found_edges += offsets[v + 1] - offsets[v];
+              break;
+            }
+          }
+        }
+        thread_edges_[k] = found_edges;
+      });
+      frontier_edges = Gather(threads);
+    }
+    else {
+      unsigned int threads = frontier_edges < kParallelGrain ? 1
+        : ResolveThreadNumber(num_threads, frontier_size);
+      pool->For(frontier_size, threads, [&](unsigned int k, size_t first, size_t last) {
+        std::vector<size_t>& found = thread_nodes_[k];
+        found.clear();
+        size_t found_edges = 0;
+        for (size_t i = begin + first; i < begin + last; i++) {
+          size_t u = order_[i];
+          for (size_t e = offsets[u]; e < offsets[u + 1]; e++) {
+            size_t v = edges[e].dst;
+            if (Level(v) >= 0 || !top_down_open(e)) {
+              continue;
+            }
+            int unreached = -1;
+            if (threads == 1) {
+              levels_[v].store(next_level, std::memory_order_relaxed);
+            }
+            else if (!levels_[v].compare_exchange_strong(unreached, next_level,
+                std::memory_order_relaxed)) {
+              continue;
+            }
+            found.push_back(v);
+            found_edges += offsets[v + 1] - offsets[v];
+          }
+        }
+        thread_edges_[k] = found_edges;
+      });
+      frontier_edges = Gather(threads);
+      // Which thread claims a node depends on timing; sorting makes the
+      // order (and the solver using it) deterministic.
+      std::sort(order_.begin() + level_begin_.back(), order_.end());
+    }
+    level_begin_.push_back(order_.size());
+    unscanned_edges -= frontier_edges;
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "cmaxflow.h"
+
+#include <new>
+#include <vector>
+#include <utility>
+#include <iostream>
+
+#include "batch.h"
+#include "maxflow.h"
+
+using cmaxflow::MaxflowGraphDouble;
+
+struct cmaxflow_graph {
+  MaxflowGraphDouble solver;
+  // cmaxflow_max_preflow was called after the last build / reorder
+  bool solved = false;
+};
+
+// Exceptions (std::bad_alloc from the containers) must not cross the C
+// boundary; they are reported as failures.
+template <typename Function>
+static int Guarded(const char* name, Function f) {
+  try {
+    return f() ? 1 : 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Warning: " << name << " failed (" << e.what() << ")." << std::endl;
+    return 0;
+  }
+}
+
+extern "C" {
+
+cmaxflow_graph* cmaxflow_new(void) {
+  return new (std::nothrow) cmaxflow_graph();
+}
+
+void cmaxflow_free(cmaxflow_graph* g) {
+  delete g;
+}
+
+int cmaxflow_build(cmaxflow_graph* g, size_t edge_number,
+  const int* src, const int* dst, const double* capacity,
+  const double* reverse_capacity, int check_edge_redundancy,
+  unsigned int num_threads) {
+  return cmaxflow_build_with_node_capacities(g, edge_number, src, dst, capacity,
+    reverse_capacity, 0, NULL, NULL, check_edge_redundancy, num_threads);
+}
+
+int cmaxflow_build_with_node_capacities(cmaxflow_graph* g, size_t edge_number,
+  const int* src, const int* dst, const double* capacity,
+  const double* reverse_capacity, size_t node_number, const int* nodes,
+  const double* node_capacity, int check_edge_redundancy,
+  unsigned int num_threads) {
+  return Guarded("cmaxflow_build", [&] {
+    std::vector<std::pair<int, int>> edge_list(edge_number);
+    std::vector<double> capacities(capacity, capacity + edge_number);
+    std::vector<double> reverse_capacities;
+    for (size_t i = 0; i < edge_number; i++) {
+      edge_list[i] = std::make_pair(src[i], dst[i]);
+    }
+    if (reverse_capacity != NULL) {
+      reverse_capacities.assign(reverse_capacity, reverse_capacity + edge_number);
+    }
+    std::vector<std::pair<int, double>> node_capacities(node_number);
+    for (size_t k = 0; k < node_number; k++) {
+      node_capacities[k] = std::make_pair(nodes[k], node_capacity[k]);
+    }
+    g->solved = false;
+    return g->solver.FromEdgeList(edge_list, capacities, reverse_capacities,
+      node_capacities, check_edge_redundancy != 0, num_threads);
+  });
+}
+
+int cmaxflow_set_allocation_policy(cmaxflow_graph* g, int pages, int numa,
+  unsigned int num_threads) {
+  g->solved = false;
+  return g->solver.SetAllocationPolicy(pages, numa, num_threads) ? 1 : 0;
+}
+
+void cmaxflow_allocation_report(cmaxflow_graph* g, int* pages, int* numa,
+  size_t* large_bytes) {
+  cmaxflow::AllocationReport report = g->solver.GetAllocationReport();
+  *pages = report.pages;
+  *numa = report.numa;
+  *large_bytes = report.large_bytes;
+}
+
+int cmaxflow_set_source_sink(cmaxflow_graph* g, int s, int t) {
+  return g->solver.SetSourceSink(s, t) ? 1 : 0;
+}
+
+int cmaxflow_reorder_nodes(cmaxflow_graph* g, int method, unsigned int num_threads) {
+  return Guarded("cmaxflow_reorder_nodes", [&] {
+    g->solved = false;
+    return g->solver.ReorderNodes(method, num_threads);
+  });
+}
+
+void cmaxflow_set_flow_threshold(cmaxflow_graph* g, double flow_threshold) {
+  g->solver.SetFlowThreshold(flow_threshold);
+}
+
+void cmaxflow_set_budget(cmaxflow_graph* g, double time_limit,
+  unsigned long long work_limit) {
+  g->solver.SetBudget(time_limit, work_limit);
+}
+
+void cmaxflow_set_num_threads(cmaxflow_graph* g, unsigned int num_threads) {
+  g->solver.SetNumThreads(num_threads);
+}
+
+double cmaxflow_max_preflow(cmaxflow_graph* g, unsigned int global_relabel_frequency,
+  double tol, int selection) {
+  double flow = 0;
+  Guarded("cmaxflow_max_preflow", [&] {
+    flow = g->solver.MaxPreFlow(global_relabel_frequency, tol, selection);
+    g->solved = true;
+    return true;
+  });
+  return flow;
+}
+
+int cmaxflow_status(cmaxflow_graph* g) {
+  return g->solver.GetStatus();
+}
+
+double cmaxflow_upper_bound(cmaxflow_graph* g) {
+  return g->solver.GetUpperBound();
+}
+
+size_t cmaxflow_node_number(cmaxflow_graph* g) {
+  return g->solver.GetNodeNumber();
+}
+
+size_t cmaxflow_min_cut(cmaxflow_graph* g, int minimal_source_side,
+  int* names, char* source_side) {
+  if (!g->solved) {
+    std::cerr << "Warning: cmaxflow_min_cut must be called after cmaxflow_max_preflow." << std::endl;
+    return 0;
+  }
+  size_t n = g->solver.GetNodeNumber();
+  if (!Guarded("cmaxflow_min_cut", [&] {
+        if (minimal_source_side) {
+          g->solver.SourceSideMinCut();
+        }
+        else {
+          g->solver.MinCut();
+        }
+        return true;
+      })) {
+    return 0;
+  }
+  size_t written = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (g->solver.IsOutCopy(i)) {
+      continue;
+    }
+    names[written] = g->solver.GetNodeName(i);
+    source_side[written] = g->solver.IsOnSourceSide(i, minimal_source_side != 0) ? 1 : 0;
+    written += 1;
+  }
+  return written;
+}
+
+int cmaxflow_global_min_cut(cmaxflow_graph* g, double tol, double* value,
+  int* names, char* source_side) {
+  g->solved = false;
+  if (!Guarded("cmaxflow_global_min_cut", [&] { return g->solver.GlobalMinCut(tol); })) {
+    return 0;
+  }
+  size_t n = g->solver.GetNodeNumber();
+  for (size_t i = 0; i < n; i++) {
+    names[i] = g->solver.GetNodeName(i);
+    source_side[i] = g->solver.IsOnGlobalCutSourceSide(i) ? 1 : 0;
+  }
+  *value = g->solver.GetGlobalCutValue();
+  return 1;
+}
+
+int cmaxflow_solve_batch(size_t graph_number, const int64_t* node_offsets,
+  const int64_t* edge_offsets, const int* src, const int* dst,
+  const double* capacity, const double* reverse_capacity,
+  const int* sources, const int* sinks, double tol, unsigned int num_threads,
+  double* flows, uint8_t* source_side) {
+  return Guarded("cmaxflow_solve_batch", [&] {
+    return cmaxflow::SolveBatch<double>(graph_number, node_offsets, edge_offsets,
+      src, dst, capacity, reverse_capacity, sources, sinks, tol, num_threads,
+      flows, source_side);
+  });
+}
+
+}
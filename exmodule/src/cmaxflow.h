@@ -0,0 +1,129 @@
+#ifndef _CMAXFLOW_H
+#define _CMAXFLOW_H
+
+/*
+ * C API of the max-flow solver (MaxflowGraph<double>), for programs that
+ * call it in-process without Python. Link against the cmaxflow library
+ * built by CMakeLists.txt.
+ *
+ * Functions returning int return 1 on success and 0 on failure; warnings
+ * are printed to stderr as in the C++ classes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Active-node selection rules (see selection.h) */
+#define CMAXFLOW_HIGHEST_LABEL 0
+#define CMAXFLOW_FIFO 1
+#define CMAXFLOW_LIFO 2
+
+/* Node orders (see reorder.h) */
+#define CMAXFLOW_NO_REORDER 0
+#define CMAXFLOW_BFS_REORDER 1
+#define CMAXFLOW_RCM_REORDER 2
+#define CMAXFLOW_DEGREE_REORDER 3
+
+/* Allocation policies (see memory.h) */
+#define CMAXFLOW_DEFAULT_PAGES 0
+#define CMAXFLOW_TRANSPARENT_HUGE_PAGES 1
+#define CMAXFLOW_EXPLICIT_HUGE_PAGES 2
+#define CMAXFLOW_NO_NUMA_POLICY 0
+#define CMAXFLOW_FIRST_TOUCH 1
+#define CMAXFLOW_INTERLEAVE 2
+
+/* Status of the last cmaxflow_max_preflow call */
+#define CMAXFLOW_OPTIMAL 0
+#define CMAXFLOW_THRESHOLD_REACHED 1
+#define CMAXFLOW_THRESHOLD_UNREACHABLE 2
+#define CMAXFLOW_TIME_LIMIT 3
+#define CMAXFLOW_WORK_LIMIT 4
+
+typedef struct cmaxflow_graph cmaxflow_graph;
+
+cmaxflow_graph* cmaxflow_new(void);
+void cmaxflow_free(cmaxflow_graph* g);
+
+/* Build the graph from edge_number edges src[i] -> dst[i] (node names) with
+ * capacity[i]. reverse_capacity may be NULL (zero capacities from dst[i] to
+ * src[i]). num_threads = 0 uses all hardware threads. */
+int cmaxflow_build(cmaxflow_graph* g, size_t edge_number,
+  const int* src, const int* dst, const double* capacity,
+  const double* reverse_capacity, int check_edge_redundancy,
+  unsigned int num_threads);
+
+/* Same as cmaxflow_build, where each node nodes[k] can pass at most
+ * node_capacity[k] (k < node_number). */
+int cmaxflow_build_with_node_capacities(cmaxflow_graph* g, size_t edge_number,
+  const int* src, const int* dst, const double* capacity,
+  const double* reverse_capacity, size_t node_number, const int* nodes,
+  const double* node_capacity, int check_edge_redundancy,
+  unsigned int num_threads);
+
+/* Huge pages and NUMA placement of the graph arrays; call it before
+ * cmaxflow_build. num_threads is used by first-touch placement. */
+int cmaxflow_set_allocation_policy(cmaxflow_graph* g, int pages, int numa,
+  unsigned int num_threads);
+/* Policies that took effect for the current graph, and the bytes they
+ * apply to (arrays under 2 MiB use the default allocator). */
+void cmaxflow_allocation_report(cmaxflow_graph* g, int* pages, int* numa,
+  size_t* large_bytes);
+
+int cmaxflow_set_source_sink(cmaxflow_graph* g, int s, int t);
+int cmaxflow_reorder_nodes(cmaxflow_graph* g, int method, unsigned int num_threads);
+
+/* Early exit (see MaxflowGraph::SetFlowThreshold and SetBudget) */
+void cmaxflow_set_flow_threshold(cmaxflow_graph* g, double flow_threshold);
+void cmaxflow_set_budget(cmaxflow_graph* g, double time_limit,
+  unsigned long long work_limit);
+
+/* Threads of the breadth-first searches of the global relabeling and the
+ * min cut (0 = all hardware threads, 1 by default). */
+void cmaxflow_set_num_threads(cmaxflow_graph* g, unsigned int num_threads);
+
+/* Return the maximum flow value (a lower bound after an early exit). */
+double cmaxflow_max_preflow(cmaxflow_graph* g, unsigned int global_relabel_frequency,
+  double tol, int selection);
+int cmaxflow_status(cmaxflow_graph* g);
+double cmaxflow_upper_bound(cmaxflow_graph* g);
+
+/* Number of nodes (including internal copies of nodes with capacities). */
+size_t cmaxflow_node_number(cmaxflow_graph* g);
+
+/* Compute a minimum cut after cmaxflow_max_preflow. For every node (but
+ * the internal copies), write its name to names and 1 (source side) or
+ * 0 (sink side) to source_side; both arrays need cmaxflow_node_number
+ * entries. minimal_source_side selects the cut with the smallest source
+ * side instead of the largest. Return the number of nodes written. */
+size_t cmaxflow_min_cut(cmaxflow_graph* g, int minimal_source_side,
+  int* names, char* source_side);
+
+/* Global minimum cut: the cut of smallest capacity over all partitions of
+ * the nodes, regardless of the source and sink. Writes its value, and names
+ * and source_side as cmaxflow_min_cut. Discards the flows of
+ * cmaxflow_max_preflow. Fails for graphs with node capacities. */
+int cmaxflow_global_min_cut(cmaxflow_graph* g, double tol, double* value,
+  int* names, char* source_side);
+
+/* Solve graph_number small graphs in one call, with num_threads threads
+ * (0 = all hardware threads). Graph g has the nodes
+ * 0 .. node_offsets[g + 1] - node_offsets[g] - 1 and the edges
+ * [edge_offsets[g], edge_offsets[g + 1]) of src, dst, capacity and
+ * reverse_capacity (may be NULL). flows[g] receives its flow value and
+ * source_side[node_offsets[g] + v] is 1 for the nodes on the source side of
+ * its minimum cut. Return 0 if the batch is malformed. */
+int cmaxflow_solve_batch(size_t graph_number, const int64_t* node_offsets,
+  const int64_t* edge_offsets, const int* src, const int* dst,
+  const double* capacity, const double* reverse_capacity,
+  const int* sources, const int* sinks, double tol, unsigned int num_threads,
+  double* flows, uint8_t* source_side);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -11,10 +11,19 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <limits>
 
+#ifdef CMAXFLOW_WITH_PYTHON
 #include <Python.h>
+#endif
 
 #include "utils.h"
+#include "memory.h"
+#include "parallel.h"
+#include "shared.h"
 
 namespace cmaxflow {
 
@@ -25,13 +34,14 @@ template <typename FlowType> class Graph;
 typedef Graph<double> GraphDouble;
 typedef Graph<int> GraphInt;
 
+// Immutable part of an edge. Endpoints are node indices and reversed is the
+// position of the paired edge in the edge array, so that edges can be shared
+// between processes. Flows are kept separately (Graph::GetFlow).
 template <typename FlowType>
 struct Edge {
-  Node<FlowType>* src;
-  Node<FlowType>* dst;
-  FlowType flow;
+  size_t src;
+  size_t dst;
   FlowType capacity;
-  //Edge<FlowType> reversed;
   size_t reversed;
 };
 
@@ -56,32 +66,97 @@ public:
   Graph();
   Graph(size_t max_node_num);
   ~Graph();
+  Graph(const Graph&) = delete;
+  Graph& operator=(const Graph&) = delete;
 
   void Reset();
 
-  typedef std::vector<Edge<FlowType>> EdgeList;
-
-  bool FromEdgeList(std::vector<std::pair<int, int>> edge_list,
-    std::vector<FlowType> capacities, bool check_edge_redundancy);
-  bool FromPyObject(PyObject* p, bool check_edge_redundancy);
+  // Large arrays follow the allocation policy (see memory.h).
+  typedef std::vector<Node<FlowType>, PolicyAllocator<Node<FlowType>>> NodeList;
+  typedef std::vector<Edge<FlowType>, PolicyAllocator<Edge<FlowType>>> EdgeList;
+  typedef std::vector<size_t, PolicyAllocator<size_t>> OffsetList;
+  typedef std::vector<FlowType, PolicyAllocator<FlowType>> FlowList;
+
+  // num_threads = 0 uses all hardware threads.
+  bool FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+    const std::vector<FlowType>& capacities, bool check_edge_redundancy,
+    unsigned int num_threads = 0);
+  // reverse_capacities[i] is the capacity of the i-th edge from its
+  // destination to its source; both directions share one edge pair.
+  // An empty vector means zero reverse capacities.
+  bool FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+    const std::vector<FlowType>& capacities,
+    const std::vector<FlowType>& reverse_capacities, bool check_edge_redundancy,
+    unsigned int num_threads = 0);
+  // node_capacities holds (name, capacity) of nodes with a capacity.
+  // Such nodes are split internally (see SplitNodes).
+  bool FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+    const std::vector<FlowType>& capacities,
+    const std::vector<FlowType>& reverse_capacities,
+    const std::vector<std::pair<int, FlowType>>& node_capacities,
+    bool check_edge_redundancy, unsigned int num_threads = 0);
+#ifdef CMAXFLOW_WITH_PYTHON
+  bool FromPyObject(PyObject* p, bool check_edge_redundancy,
+    unsigned int num_threads = 0);
+  bool FromPyObject(PyObject* p,
+    const std::vector<std::pair<int, FlowType>>& node_capacities,
+    bool check_edge_redundancy, unsigned int num_threads = 0);
+#endif
 
   size_t GetNodeNumber();
   size_t GetEdgeNumber();
   size_t GetOutEdgeNumber(size_t src_index);
 
-  //Edge<FlowType>* AddEdge(Node<FlowType>* src, Node<FlowType>* dst, FlowType capacity);
-  size_t AddEdge(Node<FlowType>* src, Node<FlowType>* dst, FlowType capacity);
-  //void AddEdgePair(Node<FlowType>* src, Node<FlowType>* dst, FlowType capacity);
-  Node<FlowType>* AddNode(int name);
-  //size_t AddNode(int name);
+  // Raw CSR arrays: out-edges of node i are edges [offsets[i], offsets[i + 1]).
+  const size_t* GetOffsets() { return offsets_; }
+  const Edge<FlowType>* GetEdges() { return edges_; }
 
   Node<FlowType>* GetNode(size_t index);
   Node<FlowType>* GetNodeByName(int name);
-  Edge<FlowType>* GetEdge(size_t src_index, size_t edge_index);
-  Edge<FlowType>* GetReversedEdge(Edge<FlowType>* edge);
+  const Edge<FlowType>* GetEdge(size_t src_index, size_t edge_index);
+  const Edge<FlowType>* GetReversedEdge(const Edge<FlowType>* edge);
+  Node<FlowType>* GetSrc(const Edge<FlowType>* edge) { return &node_list_[edge->src]; }
+  Node<FlowType>* GetDst(const Edge<FlowType>* edge) { return &node_list_[edge->dst]; }
+  FlowType& GetFlow(const Edge<FlowType>* edge) { return flow_list_[edge - edges_]; }
+  FlowType GetResidual(const Edge<FlowType>* edge) { return edge->capacity - GetFlow(edge); }
+  void ClearFlows();
+
+  // A node v with a capacity is stored as v (the in-copy, which keeps the
+  // edges into v) and an out-copy named above all node names (which keeps
+  // the edges out of v). Both getters return node itself for other nodes.
+  bool HasNodeCapacities() { return !split_names_.empty(); }
+  bool IsOutCopy(Node<FlowType>* node) {
+    return HasNodeCapacities() && node->name >= first_out_copy_name_;
+  }
+  Node<FlowType>* GetOutCopy(Node<FlowType>* node);
+  Node<FlowType>* GetInCopy(Node<FlowType>* node);
+
+  // Copy the edges and node names to a new POSIX shared-memory object, which
+  // other processes (or this one) can attach to with AttachShared.
+  bool ExportShared(const std::string& name);
+  // Use the edges of a shared-memory object without copying them.
+  // Only node states and flows are allocated by this process.
+  bool AttachShared(const std::string& name);
+  static bool UnlinkShared(const std::string& name);
+  bool IsShared() { return segment_.mapped(); }
+
+  // Huge pages (PagePolicy) and NUMA placement (NumaPolicy) of the node,
+  // offset, edge and flow arrays; num_threads is the thread number of the
+  // parallel phases, used by first-touch placement (0 = all hardware
+  // threads). Drops the current graph, so call it before building.
+  bool SetAllocationPolicy(int pages, int numa, unsigned int num_threads = 0);
+  // Policies that took effect for the arrays of the current graph.
+  AllocationReport GetAllocationReport() { return allocation_.Report(); }
+
+  // Renumber nodes so that the node with index i gets index new_index[i].
+  // Out-edges of each node are sorted by destination index.
+  // Names, capacities and flows are kept.
+  bool Reorder(const std::vector<size_t>& new_index, unsigned int num_threads = 1);
 
   std::string ToString();
+#ifdef CMAXFLOW_WITH_PYTHON
   PyObject* ToPythonString();
+#endif
 
 
 private:
@@ -89,26 +164,59 @@ private:
   size_t node_number_;
   size_t edge_number_;
 
-  //std::map<int, Node<FlowType>*> name_map_;
   std::map<int, size_t> name_map_;
-  //std::vector<int> name_list_;
-  std::vector<Node<FlowType>> node_list_;
-  std::vector<EdgeList> adjacency_list_;
+  // Declared before the arrays, which release their blocks to it.
+  AllocationState allocation_;
+  NodeList node_list_;
+  // Edges are stored grouped by their source node (CSR layout):
+  // the out-edges of node i are edges_[offsets_[i] .. offsets_[i + 1]).
+  // edges_ and offsets_ point to edge_list_ and edge_offsets_, or into segment_
+  // for a graph attached to shared memory.
+  const Edge<FlowType>* edges_;
+  const size_t* offsets_;
+  EdgeList edge_list_;
+  OffsetList edge_offsets_;
+  FlowList flow_list_;
+  SharedSegment segment_;
+
+  // Names of the split nodes; the k-th one has the out-copy named
+  // first_out_copy_name_ + k.
+  std::vector<int> split_names_;
+  std::map<int, size_t> split_index_;
+  int first_out_copy_name_;
+
+  void UseOwnedEdges();
+
+  void RemapNames(const std::vector<std::pair<int, int>>& edge_list,
+    unsigned int num_threads, std::vector<size_t>* endpoints);
+  void MergeRedundantEdges(std::vector<size_t>* endpoints,
+    const std::vector<FlowType>& capacities, const FlowType* input_reverse_capacities,
+    unsigned int num_threads,
+    std::vector<FlowType>* merged_capacities,
+    std::vector<FlowType>* reverse_capacities);
+  bool SplitNodes(const std::vector<std::pair<int, FlowType>>& node_capacities,
+    const FlowType* capacities, const FlowType* reverse_capacities,
+    std::vector<size_t>* endpoints, std::vector<FlowType>* split_capacities,
+    std::vector<FlowType>* split_reverse_capacities);
+  void BuildEdges(const std::vector<size_t>& endpoints,
+    const FlowType* capacities, const FlowType* reverse_capacities,
+    unsigned int num_threads);
 
 };
 
 
 // Implementation
 template <typename FlowType>
-Graph<FlowType>::Graph() {
-  max_node_num_ = 0;
-  //Reset();
-}
+Graph<FlowType>::Graph() : Graph((size_t) 0) {}
 
 template <typename FlowType>
-Graph<FlowType>::Graph(size_t max_node_num) {
+Graph<FlowType>::Graph(size_t max_node_num)
+  : node_list_(PolicyAllocator<Node<FlowType>>(&allocation_)),
+    edge_list_(PolicyAllocator<Edge<FlowType>>(&allocation_)),
+    edge_offsets_(PolicyAllocator<size_t>(&allocation_)),
+    flow_list_(PolicyAllocator<FlowType>(&allocation_)) {
   max_node_num_ = max_node_num;
-  //Reset();
+  Reset();
 }
 
 template <typename FlowType>
@@ -119,13 +227,42 @@ void Graph<FlowType>::Reset(){
   node_number_ = 0;
   edge_number_ = 0;
   name_map_.clear();
-  //name_list_.clear();
   node_list_.clear();
-  adjacency_list_.clear();
+  edge_list_.clear();
+  edge_offsets_.assign(1, 0);
+  flow_list_.clear();
+  split_names_.clear();
+  split_index_.clear();
+  first_out_copy_name_ = 0;
+  segment_.Unmap();
   if (max_node_num_ > 0) {
     node_list_.reserve(max_node_num_);
-    adjacency_list_.reserve(max_node_num_);
+    edge_offsets_.reserve(max_node_num_ + 1);
+  }
+  UseOwnedEdges();
+}
+
+template <typename FlowType>
+bool Graph<FlowType>::SetAllocationPolicy(int pages, int numa, unsigned int num_threads) {
+  if (pages < kDefaultPages || pages > kExplicitHugePages
+      || numa < kNoNumaPolicy || numa > kInterleave) {
+    std::cerr << "Warning: unknown allocation policy (" << pages << ", " << numa << ")." << std::endl;
+    return false;
   }
+  // clear() keeps the blocks, which were allocated with the old policy.
+  NodeList(node_list_.get_allocator()).swap(node_list_);
+  EdgeList(edge_list_.get_allocator()).swap(edge_list_);
+  OffsetList(edge_offsets_.get_allocator()).swap(edge_offsets_);
+  FlowList(flow_list_.get_allocator()).swap(flow_list_);
+  allocation_.SetPolicy(pages, numa, num_threads);
+  Reset();
+  return true;
+}
+
+template <typename FlowType>
+void Graph<FlowType>::UseOwnedEdges() {
+  edges_ = edge_list_.data();
+  offsets_ = edge_offsets_.data();
 }
 
 template <typename FlowType>
@@ -140,7 +277,7 @@ size_t Graph<FlowType>::GetEdgeNumber() {
 
 template <typename FlowType>
 size_t Graph<FlowType>::GetOutEdgeNumber(size_t src_index) {
-  return adjacency_list_[src_index].size();
+  return offsets_[src_index + 1] - offsets_[src_index];
 }
 
 template <typename FlowType>
@@ -159,186 +296,694 @@ Node<FlowType>* Graph<FlowType>::GetNodeByName(int name) {
 }
 
 template <typename FlowType>
-Edge<FlowType>* Graph<FlowType>::GetEdge(size_t src_index, size_t edge_index) {
-  return &adjacency_list_[src_index][edge_index];
+const Edge<FlowType>* Graph<FlowType>::GetEdge(size_t src_index, size_t edge_index) {
+  return &edges_[offsets_[src_index] + edge_index];
 }
 
 template <typename FlowType>
-Edge<FlowType>* Graph<FlowType>::GetReversedEdge(Edge<FlowType>* edge) {
-  return &adjacency_list_[edge->dst->index][edge->reversed];
+const Edge<FlowType>* Graph<FlowType>::GetReversedEdge(const Edge<FlowType>* edge) {
+  return &edges_[edge->reversed];
 }
 
-// Add a new node with a given integer-valued name, and return its pointer.
-// If the node already exists, this method returns the existing one.
 template <typename FlowType>
-Node<FlowType>* Graph<FlowType>::AddNode(int name) {
-  if (name_map_.count(name) != 0) {
-#ifdef VERBOSE
-  std::cout << "node name " << name << " is already added. Returned node #"
-  << node_list_[name_map_[name]].index << std::endl;
-#endif
-    return &node_list_[name_map_[name]];
-    //return name_map_[name];
-  }
-  else {
-    Node<FlowType> node;
-    node.name = name;
+void Graph<FlowType>::ClearFlows() {
+  std::fill(flow_list_.begin(), flow_list_.end(), 0);
+}
 
-    node.excess = 0;
-    node.height = 0;
-    node.current_edge_idx = 0;
-    //node->next_in_bucket = nullptr;
-    //node->prev_in_bucket = nullptr;
-    node.index_in_bucket = 0;
-    node.index = node_list_.size();
-    node_list_.push_back(node);
+template <typename FlowType>
+Node<FlowType>* Graph<FlowType>::GetOutCopy(Node<FlowType>* node) {
+  auto it = split_index_.find(node->name);
+  if (it == split_index_.end() || IsOutCopy(node)) {
+    return node;
+  }
+  return GetNodeByName(first_out_copy_name_ + (int) it->second);
+}
 
-    name_map_[name] = node.index;
-    adjacency_list_.push_back(std::vector<Edge<FlowType>>());
-  #ifdef VERBOSE
-    std::cout << "added node #" << name << " to graph (index = " << node.index << ")" << std::endl;
-  #endif
-    node_number_ += 1;
-    return &node_list_.back();
+template <typename FlowType>
+Node<FlowType>* Graph<FlowType>::GetInCopy(Node<FlowType>* node) {
+  if (!IsOutCopy(node)) {
+    return node;
   }
+  return GetNodeByName(split_names_[node->name - first_out_copy_name_]);
 }
 
 template <typename FlowType>
-size_t Graph<FlowType>::AddEdge(Node<FlowType>* src, Node<FlowType>* dst, FlowType capacity) {
-  //Edge<FlowType>* edge = new Edge<FlowType>();
-  Edge<FlowType> edge;
-  edge.src = src;
-  edge.dst = dst;
-  edge.flow = 0;
-  edge.capacity = capacity;
-  edge.reversed = 0;
-  size_t index = src->index;
-  adjacency_list_[index].push_back(edge);
-  edge_number_ += 1;
-#ifdef VERBOSE
-  std::cout << "added edge (" << src.name << ", " << dst.name << ") to graph" << std::endl;
-#endif
-  return adjacency_list_[index].size() - 1;
+bool Graph<FlowType>::FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+  const std::vector<FlowType>& capacities, bool check_edge_redundancy,
+  unsigned int num_threads) {
+  return FromEdgeList(edge_list, capacities, std::vector<FlowType>(),
+    check_edge_redundancy, num_threads);
 }
 
-/*
-template <typename FlowType>
-void Graph<FlowType>::AddEdgePair(Node<FlowType>* src, Node<FlowType>* dst, FlowType capacity) {
-  Edge<FlowType> edge;
-  Edge<FlowType> edge_rev;
-  edge.src = src;
-  edge.dst = dst;
-  edge.flow = 0;
-  edge.capacity = capacity;
-  edge_rev.src = dst;
-  edge_rev.dst = src;
-  edge_rev.flow = 0;
-  edge_rev.capacity = 0;
-  adjacency_list_[src->index].push_back(edge);
-  adjacency_list_[dst->index].push_back(edge);
-  (adjacency_list_[src->index].back()).reversed = &(adjacency_list_[dst->index].back());
-  (adjacency_list_[dst->index].back()).reversed = &(adjacency_list_[src->index].back());
-  edge_number_ += 2;
+template <typename FlowType>
+bool Graph<FlowType>::FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+  const std::vector<FlowType>& capacities,
+  const std::vector<FlowType>& reverse_capacities, bool check_edge_redundancy,
+  unsigned int num_threads) {
+  return FromEdgeList(edge_list, capacities, reverse_capacities,
+    std::vector<std::pair<int, FlowType>>(), check_edge_redundancy, num_threads);
 }
-*/
 
 template <typename FlowType>
-bool Graph<FlowType>::FromEdgeList(std::vector<std::pair<int, int>> edge_list,
-  std::vector<FlowType> capacities, bool check_edge_redundancy) {
+bool Graph<FlowType>::FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+  const std::vector<FlowType>& capacities,
+  const std::vector<FlowType>& reverse_capacities,
+  const std::vector<std::pair<int, FlowType>>& node_capacities,
+  bool check_edge_redundancy, unsigned int num_threads) {
   Reset();
   size_t n = edge_list.size();
   if (capacities.size() != n) {
     std::cerr << "Warning: sizes of edge_list and capacities mismatch." << std::endl;
     return false;
   }
+  if (!reverse_capacities.empty() && reverse_capacities.size() != n) {
+    std::cerr << "Warning: sizes of edge_list and reverse capacities mismatch." << std::endl;
+    return false;
+  }
+  const FlowType* input_reverse_capacities =
+    reverse_capacities.empty() ? nullptr : reverse_capacities.data();
+  num_threads = ResolveThreadNumber(num_threads, n);
 #ifdef VERBOSE
   std::cout << "#edges = " << n << std::endl;
   std::cout << "check redundancy: " << check_edge_redundancy << std::endl;
+  std::cout << "#threads = " << num_threads << std::endl;
+#endif
+  // endpoints[2 * i] and endpoints[2 * i + 1] are the node indices of
+  // the source and the destination of the i-th edge.
+  std::vector<size_t> endpoints;
+  RemapNames(edge_list, num_threads, &endpoints);
+
+  const FlowType* edge_capacities = capacities.data();
+  const FlowType* edge_reverse_capacities = input_reverse_capacities;
+  std::vector<FlowType> merged_capacities;
+  std::vector<FlowType> merged_reverse_capacities;
+  if (check_edge_redundancy) {
+    // Add a new pair of an edge and a reversed edge.
+    // If there is an existing pair, increase the capacity values.
+    MergeRedundantEdges(&endpoints, capacities, input_reverse_capacities,
+      num_threads, &merged_capacities, &merged_reverse_capacities);
+    edge_capacities = merged_capacities.data();
+    edge_reverse_capacities = merged_reverse_capacities.data();
+  }
+
+  if (!node_capacities.empty()) {
+    std::vector<FlowType> split_capacities;
+    std::vector<FlowType> split_reverse_capacities;
+    if (!SplitNodes(node_capacities, edge_capacities, edge_reverse_capacities,
+        &endpoints, &split_capacities, &split_reverse_capacities)) {
+      Reset();
+      return false;
+    }
+    BuildEdges(endpoints, split_capacities.data(), split_reverse_capacities.data(),
+      num_threads);
+  }
+  else {
+    // Add a new edge pair without redundancy check.
+    BuildEdges(endpoints, edge_capacities, edge_reverse_capacities, num_threads);
+  }
+  return true;
+}
+
+// Assign node indices in the order of first appearance in edge_list
+// (source before destination), and fill name_map_ and node_list_.
+// Names are deduplicated by a parallel sort instead of one map lookup per
+// endpoint, so this is the same numbering as inserting the names one by one.
+template <typename FlowType>
+void Graph<FlowType>::RemapNames(const std::vector<std::pair<int, int>>& edge_list,
+  unsigned int num_threads, std::vector<size_t>* endpoints) {
+  size_t n = 2 * edge_list.size();
+  auto name_at = [&](size_t pos) {
+    return pos % 2 == 0 ? edge_list[pos / 2].first : edge_list[pos / 2].second;
+  };
+
+  std::vector<int> names(n);
+  ParallelFor(n, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t pos = begin; pos < end; pos++) {
+      names[pos] = name_at(pos);
+    }
+  });
+  ParallelSort(&names, num_threads, std::less<int>());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  size_t node_num = names.size();
+
+  // First position of each distinct name, and the rank of the name in `names`
+  // for each endpoint.
+  std::vector<std::atomic<size_t>> first_pos(node_num);
+  for (size_t i = 0; i < node_num; i++) {
+    first_pos[i].store(n, std::memory_order_relaxed);
+  }
+  endpoints->resize(n);
+  ParallelFor(n, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t pos = begin; pos < end; pos++) {
+      size_t rank = std::lower_bound(names.begin(), names.end(), name_at(pos)) - names.begin();
+      (*endpoints)[pos] = rank;
+      size_t current = first_pos[rank].load(std::memory_order_relaxed);
+      while (pos < current && !first_pos[rank].compare_exchange_weak(current, pos)) {}
+    }
+  });
+
+  std::vector<size_t> order(node_num);
+  for (size_t i = 0; i < node_num; i++) {
+    order[i] = i;
+  }
+  ParallelSort(&order, num_threads, [&](size_t a, size_t b) {
+    return first_pos[a].load(std::memory_order_relaxed) < first_pos[b].load(std::memory_order_relaxed);
+  });
+  std::vector<size_t> index_of_rank(node_num);
+  for (size_t i = 0; i < node_num; i++) {
+    index_of_rank[order[i]] = i;
+  }
+  ParallelFor(n, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t pos = begin; pos < end; pos++) {
+      (*endpoints)[pos] = index_of_rank[(*endpoints)[pos]];
+    }
+  });
+
+  node_list_.resize(node_num);
+  for (size_t i = 0; i < node_num; i++) {
+    Node<FlowType>& node = node_list_[i];
+    node.name = names[order[i]];
+    node.index = i;
+    node.excess = 0;
+    node.height = 0;
+    node.current_edge_idx = 0;
+    node.index_in_bucket = 0;
+  }
+  for (size_t rank = 0; rank < node_num; rank++) {
+    name_map_.emplace_hint(name_map_.end(), names[rank], index_of_rank[rank]);
+  }
+  node_number_ = node_num;
+#ifdef VERBOSE
+  std::cout << "#nodes = " << node_num << std::endl;
 #endif
+}
+
+// Merge edges connecting the same pair of nodes into one edge pair.
+// The first edge between u and v decides the direction of the pair;
+// later (u, v) edges add to its capacity and (v, u) edges add to the capacity
+// of the reversed edge (and their reverse capacities the other way round).
+// Pairs are kept in the order of their first edge.
+template <typename FlowType>
+void Graph<FlowType>::MergeRedundantEdges(std::vector<size_t>* endpoints,
+  const std::vector<FlowType>& capacities, const FlowType* input_reverse_capacities,
+  unsigned int num_threads,
+  std::vector<FlowType>* merged_capacities,
+  std::vector<FlowType>* reverse_capacities) {
+  size_t n = capacities.size();
+  std::vector<size_t>& ep = *endpoints;
+  auto key = [&](size_t i) {
+    return std::make_pair(std::min(ep[2 * i], ep[2 * i + 1]), std::max(ep[2 * i], ep[2 * i + 1]));
+  };
+
+  std::vector<size_t> order(n);
   for (size_t i = 0; i < n; i++) {
-    int src = edge_list[i].first;
-    int dst = edge_list[i].second;
-    Node<FlowType>* src_node = AddNode(src);
-    //size_t src_node = AddNode(src);
-    Node<FlowType>* dst_node = AddNode(dst);
-    //size_t dst_node = AddNode(dst);
-
-    EdgeList from_src = adjacency_list_[src_node->index];
-    //EdgeList from_src = adjacency_list_[node_list_[src_node].index];
-    EdgeList from_dst = adjacency_list_[dst_node->index];
-    //EdgeList from_dst = adjacency_list_[node_list_[dst_node].index];
-
-    if (check_edge_redundancy) {
-      // Add a new pair of an edge and a reversed edge with zero capacity.
-      // If there is an existing pair, increase the capacity value.
-      auto edge_it = std::find_if(from_src.begin(), from_src.end(),
-        [&](Edge<FlowType> e){
-          return e.src->index == src_node->index && e.dst->index == dst_node->index;
-        });
-      if (edge_it != from_src.end()) {
-        (*edge_it).capacity += capacities[i];
-        //*edge_it->reverced->capacity += 0;
+    order[i] = i;
+  }
+  ParallelSort(&order, num_threads, [&](size_t a, size_t b) {
+    auto ka = key(a);
+    auto kb = key(b);
+    return ka < kb || (ka == kb && a < b);
+  });
+
+  // head[i] is true if the i-th edge is the first one of its pair.
+  std::vector<char> head(n, 0);
+  std::vector<FlowType> forward(n, 0);
+  std::vector<FlowType> backward(n, 0);
+  for (size_t k = 0; k < n; ) {
+    size_t first = order[k];
+    head[first] = 1;
+    size_t j = k;
+    for (; j < n && key(order[j]) == key(first); j++) {
+      size_t i = order[j];
+      FlowType reverse_capacity =
+        input_reverse_capacities == nullptr ? 0 : input_reverse_capacities[i];
+      if (ep[2 * i] == ep[2 * first]) {
+        forward[first] += capacities[i];
+        backward[first] += reverse_capacity;
       }
       else {
-        size_t new_edge = AddEdge(src_node, dst_node, capacities[i]);
-        size_t new_edge_rev = AddEdge(dst_node, src_node, 0);
-        GetEdge(src_node->index, new_edge)->reversed = new_edge_rev;
-        GetEdge(dst_node->index, new_edge_rev)->reversed = new_edge;
+        forward[first] += reverse_capacity;
+        backward[first] += capacities[i];
       }
     }
+    k = j;
+  }
+
+  size_t merged = 0;
+  merged_capacities->clear();
+  reverse_capacities->clear();
+  for (size_t i = 0; i < n; i++) {
+    if (head[i]) {
+      ep[2 * merged] = ep[2 * i];
+      ep[2 * merged + 1] = ep[2 * i + 1];
+      merged_capacities->push_back(forward[i]);
+      reverse_capacities->push_back(backward[i]);
+      merged += 1;
+    }
+  }
+  ep.resize(2 * merged);
+}
+
+// Split every node v in node_capacities into v and a new out-copy node.
+// Edges out of v leave from the out-copy instead, and an edge v -> out(v)
+// carries the capacity of v. A pair with capacities in both directions at a
+// split node becomes two pairs, since the directions leave from different
+// copies. Out-copies are named max name + 1, max name + 2, ... so that the
+// name map stays sorted by appending.
+template <typename FlowType>
+bool Graph<FlowType>::SplitNodes(const std::vector<std::pair<int, FlowType>>& node_capacities,
+  const FlowType* capacities, const FlowType* reverse_capacities,
+  std::vector<size_t>* endpoints, std::vector<FlowType>* split_capacities,
+  std::vector<FlowType>* split_reverse_capacities) {
+  size_t n = node_list_.size();
+  long long max_name = name_map_.empty() ? 0 : name_map_.rbegin()->first;
+  if (max_name + (long long) node_capacities.size() >= std::numeric_limits<int>::max()) {
+    std::cerr << "Warning: no names are left for the split nodes." << std::endl;
+    return false;
+  }
+  first_out_copy_name_ = (int) max_name + 1;
+
+  std::vector<size_t> out_copy(n);
+  for (size_t i = 0; i < n; i++) {
+    out_copy[i] = i;
+  }
+  std::vector<size_t> split_nodes;
+  std::vector<FlowType> split_node_capacities;
+  for (size_t k = 0; k < node_capacities.size(); k++) {
+    auto it = name_map_.find(node_capacities[k].first);
+    if (it == name_map_.end()) {
+      std::cerr << "Warning: capacity of node " << node_capacities[k].first
+      << " is ignored (not found in graph)." << std::endl;
+      continue;
+    }
+    if (out_copy[it->second] != it->second) {
+      std::cerr << "Warning: capacity of node " << node_capacities[k].first
+      << " is given twice." << std::endl;
+      return false;
+    }
+    out_copy[it->second] = n + split_nodes.size();
+    split_nodes.push_back(it->second);
+    split_node_capacities.push_back(node_capacities[k].second);
+  }
+
+  for (size_t k = 0; k < split_nodes.size(); k++) {
+    Node<FlowType> node = node_list_[split_nodes[k]];
+    node.name = first_out_copy_name_ + (int) k;
+    node.index = n + k;
+    node_list_.push_back(node);
+    name_map_.emplace_hint(name_map_.end(), node.name, node.index);
+    split_index_.emplace(node_list_[split_nodes[k]].name, k);
+    split_names_.push_back(node_list_[split_nodes[k]].name);
+  }
+  node_number_ = node_list_.size();
+
+  size_t m = endpoints->size() / 2;
+  std::vector<size_t> split_endpoints;
+  split_endpoints.reserve(2 * (m + split_nodes.size()));
+  split_capacities->clear();
+  split_reverse_capacities->clear();
+  auto add_pair = [&](size_t src, size_t dst, FlowType capacity, FlowType reverse_capacity) {
+    split_endpoints.push_back(src);
+    split_endpoints.push_back(dst);
+    split_capacities->push_back(capacity);
+    split_reverse_capacities->push_back(reverse_capacity);
+  };
+  for (size_t i = 0; i < m; i++) {
+    size_t u = (*endpoints)[2 * i];
+    size_t v = (*endpoints)[2 * i + 1];
+    FlowType reverse_capacity = reverse_capacities == nullptr ? 0 : reverse_capacities[i];
+    if (reverse_capacity != 0 && (out_copy[u] != u || out_copy[v] != v)) {
+      add_pair(out_copy[u], v, capacities[i], 0);
+      add_pair(out_copy[v], u, reverse_capacity, 0);
+    }
     else {
-      // Add a new edge pair without redundancy check.
-      size_t new_edge = AddEdge(src_node, dst_node, capacities[i]);
-      size_t new_edge_rev = AddEdge(dst_node, src_node, 0);
-      GetEdge(src_node->index, new_edge)->reversed = new_edge_rev;
-      GetEdge(dst_node->index, new_edge_rev)->reversed = new_edge;
+      add_pair(out_copy[u], v, capacities[i], reverse_capacity);
     }
   }
+  for (size_t k = 0; k < split_nodes.size(); k++) {
+    add_pair(split_nodes[k], n + k, split_node_capacities[k], 0);
+  }
+  endpoints->swap(split_endpoints);
   return true;
 }
 
+// Build the CSR edge arrays from (source, destination) index pairs.
+// Each pair produces an edge with the given capacity and a reversed edge with
+// the reverse capacity (zero if reverse_capacities is nullptr).
+// Degrees are counted with one atomic counter per node, which then serves as
+// the write cursor of the node, so the extra memory is O(n + m) for any
+// number of threads. Threads scatter the keys of their pairs (2i for the
+// edge of pair i, 2i + 1 for its reversed edge), and each node sorts its
+// keys, so that the out-edges of a node follow the order of the input pairs
+// for any number of threads.
+template <typename FlowType>
+void Graph<FlowType>::BuildEdges(const std::vector<size_t>& endpoints,
+  const FlowType* capacities, const FlowType* reverse_capacities,
+  unsigned int num_threads) {
+  size_t n = node_list_.size();
+  size_t m = endpoints.size() / 2;
+  num_threads = ResolveThreadNumber(num_threads, m);
+  // A single thread needs no atomic read-modify-write.
+  auto fetch_increment = [num_threads](std::atomic<size_t>& counter) {
+    if (num_threads == 1) {
+      size_t value = counter.load(std::memory_order_relaxed);
+      counter.store(value + 1, std::memory_order_relaxed);
+      return value;
+    }
+    return counter.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  std::unique_ptr<std::atomic<size_t>[]> cursor(new std::atomic<size_t>[n]);
+  unsigned int node_threads = ResolveThreadNumber(num_threads, n);
+  ParallelFor(n, node_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      cursor[v].store(0, std::memory_order_relaxed);
+    }
+  });
+  ParallelFor(m, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      fetch_increment(cursor[endpoints[2 * i]]);
+      fetch_increment(cursor[endpoints[2 * i + 1]]);
+    }
+  });
+
+  std::vector<size_t> chunk_offsets(node_threads + 1, 0);
+  ParallelFor(n, node_threads, [&](unsigned int k, size_t begin, size_t end) {
+    size_t sum = 0;
+    for (size_t v = begin; v < end; v++) {
+      sum += cursor[v].load(std::memory_order_relaxed);
+    }
+    chunk_offsets[k + 1] = sum;
+  });
+  for (unsigned int k = 0; k < node_threads; k++) {
+    chunk_offsets[k + 1] += chunk_offsets[k];
+  }
+  edge_offsets_.resize(n + 1);
+  ParallelFor(n, node_threads, [&](unsigned int k, size_t begin, size_t end) {
+    size_t offset = chunk_offsets[k];
+    for (size_t v = begin; v < end; v++) {
+      size_t count = cursor[v].load(std::memory_order_relaxed);
+      edge_offsets_[v] = offset;
+      cursor[v].store(offset, std::memory_order_relaxed);
+      offset += count;
+    }
+  });
+  edge_offsets_[n] = 2 * m;
+
+  // keys[e]: key of the edge at position e; positions[key]: its position
+  std::vector<size_t> keys(2 * m);
+  ParallelFor(m, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      keys[fetch_increment(cursor[endpoints[2 * i]])] = 2 * i;
+      keys[fetch_increment(cursor[endpoints[2 * i + 1]])] = 2 * i + 1;
+    }
+  });
+  cursor.reset();
+  std::vector<size_t> positions(2 * m);
+  ParallelFor(n, node_threads, [&](unsigned int, size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      // Keys of one thread are already in order.
+      if (num_threads > 1) {
+        std::sort(keys.begin() + edge_offsets_[v], keys.begin() + edge_offsets_[v + 1]);
+      }
+      for (size_t e = edge_offsets_[v]; e < edge_offsets_[v + 1]; e++) {
+        positions[keys[e]] = e;
+      }
+    }
+  });
+
+  edge_list_.resize(2 * m);
+  ParallelFor(2 * m, ResolveThreadNumber(num_threads, 2 * m),
+    [&](unsigned int, size_t begin, size_t end) {
+      for (size_t e = begin; e < end; e++) {
+        size_t key = keys[e];
+        size_t i = key / 2;
+        Edge<FlowType>& edge = edge_list_[e];
+        if (key % 2 == 0) {
+          edge.src = endpoints[2 * i];
+          edge.dst = endpoints[2 * i + 1];
+          edge.capacity = capacities[i];
+        }
+        else {
+          edge.src = endpoints[2 * i + 1];
+          edge.dst = endpoints[2 * i];
+          edge.capacity = reverse_capacities == nullptr ? 0 : reverse_capacities[i];
+        }
+        edge.reversed = positions[key ^ 1];
+      }
+    });
+  flow_list_.assign(2 * m, 0);
+  edge_number_ = 2 * m;
+  UseOwnedEdges();
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+template <typename FlowType>
+bool Graph<FlowType>::FromPyObject(PyObject* p, bool check_edge_redundancy,
+  unsigned int num_threads) {
+  return FromPyObject(p, std::vector<std::pair<int, FlowType>>(),
+    check_edge_redundancy, num_threads);
+}
+
 template <typename FlowType>
-bool Graph<FlowType>::FromPyObject(PyObject* p, bool check_edge_redundancy) {
+bool Graph<FlowType>::FromPyObject(PyObject* p,
+  const std::vector<std::pair<int, FlowType>>& node_capacities,
+  bool check_edge_redundancy, unsigned int num_threads) {
   std::vector<std::pair<int, int>> edge_list;
   std::vector<FlowType> capacities;
-  if (!py_list_to_edge_list(p, &edge_list, &capacities)) {
+  std::vector<FlowType> reverse_capacities;
+  if (!py_list_to_edge_list(p, &edge_list, &capacities, &reverse_capacities)) {
     std::cerr << "Failed to convert a Python object to vectors." << std::endl;
     return false;
   }
-  if (!FromEdgeList(edge_list, capacities, check_edge_redundancy)) {
+  if (!FromEdgeList(edge_list, capacities, reverse_capacities, node_capacities,
+      check_edge_redundancy, num_threads)) {
+    return false;
+  }
+  return true;
+}
+#endif
+
+template <typename FlowType>
+bool Graph<FlowType>::Reorder(const std::vector<size_t>& new_index,
+  unsigned int num_threads) {
+  size_t n = node_list_.size();
+  if (IsShared()) {
+    std::cerr << "Warning: a graph in shared memory cannot be reordered." << std::endl;
+    return false;
+  }
+  if (new_index.size() != n) {
+    std::cerr << "Warning: size of the node order mismatches the number of nodes." << std::endl;
+    return false;
+  }
+  std::vector<size_t> old_index(n, n);
+  for (size_t i = 0; i < n; i++) {
+    if (new_index[i] >= n || old_index[new_index[i]] != n) {
+      std::cerr << "Warning: node order is not a permutation." << std::endl;
+      return false;
+    }
+    old_index[new_index[i]] = i;
+  }
+
+  NodeList nodes(n, Node<FlowType>(), node_list_.get_allocator());
+  OffsetList offsets(n + 1, 0, edge_offsets_.get_allocator());
+  for (size_t v = 0; v < n; v++) {
+    nodes[v] = node_list_[old_index[v]];
+    nodes[v].index = v;
+    offsets[v + 1] = offsets[v] + GetOutEdgeNumber(old_index[v]);
+  }
+
+  // new_edge_index[e]: position of the e-th old edge in the new edge list
+  size_t m = edge_list_.size();
+  std::vector<size_t> new_edge_index(m);
+  unsigned int node_threads = ResolveThreadNumber(num_threads, n);
+  ParallelFor(n, node_threads, [&](unsigned int, size_t begin, size_t end) {
+    std::vector<size_t> order;
+    for (size_t v = begin; v < end; v++) {
+      size_t first = edge_offsets_[old_index[v]];
+      order.resize(GetOutEdgeNumber(old_index[v]));
+      for (size_t j = 0; j < order.size(); j++) {
+        order[j] = first + j;
+      }
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return new_index[edge_list_[a].dst] < new_index[edge_list_[b].dst];
+      });
+      for (size_t j = 0; j < order.size(); j++) {
+        new_edge_index[order[j]] = offsets[v] + j;
+      }
+    }
+  });
+
+  EdgeList edges(m, Edge<FlowType>(), edge_list_.get_allocator());
+  FlowList flows(m, 0, flow_list_.get_allocator());
+  ParallelFor(m, ResolveThreadNumber(num_threads, m), [&](unsigned int, size_t begin, size_t end) {
+    for (size_t e = begin; e < end; e++) {
+      const Edge<FlowType>& old_edge = edge_list_[e];
+      Edge<FlowType>& edge = edges[new_edge_index[e]];
+      edge.src = new_index[old_edge.src];
+      edge.dst = new_index[old_edge.dst];
+      edge.capacity = old_edge.capacity;
+      edge.reversed = new_edge_index[old_edge.reversed];
+      flows[new_edge_index[e]] = flow_list_[e];
+    }
+  });
+
+  for (auto it = name_map_.begin(); it != name_map_.end(); it++) {
+    it->second = new_index[it->second];
+  }
+  node_list_.swap(nodes);
+  edge_list_.swap(edges);
+  edge_offsets_.swap(offsets);
+  flow_list_.swap(flows);
+  UseOwnedEdges();
+  return true;
+}
+
+template <typename FlowType>
+bool Graph<FlowType>::ExportShared(const std::string& name) {
+  if (HasNodeCapacities()) {
+    std::cerr << "Warning: a graph with node capacities cannot be shared." << std::endl;
+    return false;
+  }
+  size_t n = node_list_.size();
+  size_t m = edge_number_;
+  SharedGraphHeader header;
+  std::memcpy(header.magic, kSharedGraphMagic, sizeof(header.magic));
+  header.flow_type_size = sizeof(FlowType);
+  header.edge_size = sizeof(Edge<FlowType>);
+  header.node_number = n;
+  header.edge_number = m;
+  header.names_offset = AlignSharedOffset(sizeof(SharedGraphHeader));
+  header.offsets_offset = AlignSharedOffset(header.names_offset + n * sizeof(int));
+  header.edges_offset = AlignSharedOffset(header.offsets_offset + (n + 1) * sizeof(size_t));
+  header.total_size = header.edges_offset + m * sizeof(Edge<FlowType>);
+
+  SharedSegment segment;
+  if (!segment.Create(name, header.total_size)) {
+    return false;
+  }
+  char* base = segment.data();
+  int* names = (int*) (base + header.names_offset);
+  for (size_t i = 0; i < n; i++) {
+    names[i] = node_list_[i].name;
+  }
+  std::memcpy(base + header.offsets_offset, offsets_, (n + 1) * sizeof(size_t));
+  std::memcpy(base + header.edges_offset, edges_, m * sizeof(Edge<FlowType>));
+  std::memcpy(base, &header, sizeof(SharedGraphHeader));
+  return true;
+}
+
+template <typename FlowType>
+bool Graph<FlowType>::AttachShared(const std::string& name) {
+  Reset();
+  if (!segment_.Open(name)) {
+    return false;
+  }
+  SharedGraphHeader header;
+  if (segment_.size() < sizeof(SharedGraphHeader)) {
+    std::cerr << "Warning: shared memory " << name << " is not a graph." << std::endl;
+    Reset();
     return false;
   }
+  std::memcpy(&header, segment_.data(), sizeof(SharedGraphHeader));
+  if (std::memcmp(header.magic, kSharedGraphMagic, sizeof(header.magic)) != 0
+      || header.flow_type_size != sizeof(FlowType)
+      || header.edge_size != sizeof(Edge<FlowType>)
+      || header.total_size > segment_.size()) {
+    std::cerr << "Warning: shared memory " << name << " is not a graph of this type." << std::endl;
+    Reset();
+    return false;
+  }
+
+  size_t n = header.node_number;
+  size_t m = header.edge_number;
+  // Sections must be aligned, in order and inside the segment, and the
+  // arrays a valid CSR graph, so that a stale or foreign segment with the
+  // right magic cannot lead to reads out of bounds.
+  auto section_fits = [&](uint64_t offset, uint64_t end, uint64_t count, size_t item_size) {
+    return offset % alignof(size_t) == 0 && offset <= end && end <= header.total_size
+      && count <= (end - offset) / item_size;
+  };
+  if (n > (size_t) std::numeric_limits<int>::max()
+      || header.names_offset < sizeof(SharedGraphHeader)
+      || !section_fits(header.names_offset, header.offsets_offset, n, sizeof(int))
+      || !section_fits(header.offsets_offset, header.edges_offset, n + 1, sizeof(size_t))
+      || !section_fits(header.edges_offset, header.total_size, m, sizeof(Edge<FlowType>))) {
+    std::cerr << "Warning: shared memory " << name << " has a broken layout." << std::endl;
+    Reset();
+    return false;
+  }
+  const char* base = segment_.data();
+  const int* names = (const int*) (base + header.names_offset);
+  const size_t* offsets = (const size_t*) (base + header.offsets_offset);
+  const Edge<FlowType>* edges = (const Edge<FlowType>*) (base + header.edges_offset);
+  bool valid = offsets[0] == 0 && offsets[n] == m;
+  for (size_t v = 0; valid && v < n; v++) {
+    valid = offsets[v] <= offsets[v + 1] && offsets[v + 1] <= m;
+    for (size_t e = offsets[v]; valid && e < offsets[v + 1]; e++) {
+      const Edge<FlowType>& edge = edges[e];
+      valid = edge.src == v && edge.dst < n && edge.reversed < m
+        && edges[edge.reversed].reversed == e && edges[edge.reversed].src == edge.dst;
+    }
+  }
+  if (!valid) {
+    std::cerr << "Warning: shared memory " << name << " holds a broken graph." << std::endl;
+    Reset();
+    return false;
+  }
+  offsets_ = offsets;
+  edges_ = edges;
+
+  node_list_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    Node<FlowType>& node = node_list_[i];
+    node.name = names[i];
+    node.index = i;
+    node.excess = 0;
+    node.height = 0;
+    node.current_edge_idx = 0;
+    node.index_in_bucket = 0;
+    name_map_[names[i]] = i;
+  }
+  flow_list_.assign(m, 0);
+  node_number_ = n;
+  edge_number_ = m;
   return true;
 }
 
+template <typename FlowType>
+bool Graph<FlowType>::UnlinkShared(const std::string& name) {
+  return SharedSegment::Unlink(name);
+}
+
 // Convert to a string object in the NetworkX Edge Lists format.
 // See e.g. https://networkx.github.io/documentation/stable/reference/readwrite/edgelist.html
 template <typename FlowType>
 std::string Graph<FlowType>::ToString() {
-  auto edge_to_str = [&](Edge<FlowType> e) {
+  auto edge_to_str = [&](const Edge<FlowType>& e) {
     // Convert an edge into a string like "src dst { 'capacity': cap, 'flow': flow }"
     std::ostringstream ss;
-    ss << e.src->name << " " << e.dst->name << " ";
-    ss << "{ 'capacity': " << e.capacity << ", 'flow': " << e.flow << "}";
+    ss << node_list_[e.src].name << " " << node_list_[e.dst].name << " ";
+    ss << "{ 'capacity': " << e.capacity << ", 'flow': " << GetFlow(&e) << "}";
     return ss.str();
   };
 
   std::ostringstream ss;
 
-  for (auto edgelist_it = adjacency_list_.begin(); edgelist_it != adjacency_list_.end(); edgelist_it++) {
-    for (auto edge_it = edgelist_it->begin(); edge_it != edgelist_it->end(); edge_it++) {
-      ss << edge_to_str(*edge_it) << "\n";
-    }
+  for (size_t i = 0; i < edge_number_; i++) {
+    ss << edge_to_str(edges_[i]) << "\n";
   }
 
   return ss.str();
 }
 
+#ifdef CMAXFLOW_WITH_PYTHON
 template <typename FlowType>
 PyObject* Graph<FlowType>::ToPythonString() {
   std::string str = ToString();
   return PyUnicode_FromString(str.data());
 }
+#endif
 
 
 }
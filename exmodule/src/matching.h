@@ -0,0 +1,122 @@
+#ifndef _MATCHING_H
+#define _MATCHING_H
+
+#include <cstddef>
+#include <vector>
+#include <limits>
+
+namespace cmaxflow {
+
+const size_t kNoMatch = std::numeric_limits<size_t>::max();
+
+// Hopcroft-Karp maximum bipartite matching in O(m sqrt(n)).
+// Left nodes are 0, ..., left_number - 1 and the neighbours of left node u
+// are adjacency[offsets[u] .. offsets[u + 1]) (right node indices).
+class HopcroftKarp {
+public:
+  HopcroftKarp(size_t left_number, size_t right_number,
+    const std::vector<size_t>& offsets, const std::vector<size_t>& adjacency)
+    : left_number_(left_number), offsets_(offsets), adjacency_(adjacency),
+      matched_arc_(left_number, kNoMatch), match_right_(right_number, kNoMatch),
+      distance_(left_number), current_arc_(left_number) {}
+
+  // Compute a maximum matching and return its size.
+  size_t Solve() {
+    size_t size = 0;
+    while (Bfs()) {
+      for (size_t u = 0; u < left_number_; u++) {
+        current_arc_[u] = offsets_[u];
+      }
+      for (size_t u = 0; u < left_number_; u++) {
+        if (matched_arc_[u] == kNoMatch && Augment(u)) {
+          size += 1;
+        }
+      }
+    }
+    return size;
+  }
+
+  // Position in adjacency of the edge matched to left node u, or kNoMatch.
+  size_t MatchedArc(size_t u) const { return matched_arc_[u]; }
+
+private:
+  size_t left_number_;
+  const std::vector<size_t>& offsets_;
+  const std::vector<size_t>& adjacency_;
+  std::vector<size_t> matched_arc_;
+  std::vector<size_t> match_right_;
+  std::vector<size_t> distance_;
+  std::vector<size_t> current_arc_;
+  std::vector<size_t> stack_;
+
+  size_t MatchLeft(size_t v) const { return match_right_[v]; }
+
+  // Layer the left nodes by the length of alternating paths from the free
+  // left nodes. Return true if a free right node is reachable.
+  bool Bfs() {
+    std::vector<size_t> queue;
+    queue.reserve(left_number_);
+    for (size_t u = 0; u < left_number_; u++) {
+      if (matched_arc_[u] == kNoMatch) {
+        distance_[u] = 0;
+        queue.push_back(u);
+      }
+      else {
+        distance_[u] = kNoMatch;
+      }
+    }
+    bool found = false;
+    for (size_t head = 0; head < queue.size(); head++) {
+      size_t u = queue[head];
+      for (size_t a = offsets_[u]; a < offsets_[u + 1]; a++) {
+        size_t w = MatchLeft(adjacency_[a]);
+        if (w == kNoMatch) {
+          found = true;
+        }
+        else if (distance_[w] == kNoMatch) {
+          distance_[w] = distance_[u] + 1;
+          queue.push_back(w);
+        }
+      }
+    }
+    return found;
+  }
+
+  // Find an augmenting path from the free left node root along the layers
+  // (iterative DFS) and flip it.
+  bool Augment(size_t root) {
+    stack_.clear();
+    stack_.push_back(root);
+    while (!stack_.empty()) {
+      size_t u = stack_.back();
+      if (current_arc_[u] == offsets_[u + 1]) {
+        // Dead end: drop u from the layers of this phase.
+        distance_[u] = kNoMatch;
+        stack_.pop_back();
+        if (!stack_.empty()) {
+          current_arc_[stack_.back()] += 1;
+        }
+        continue;
+      }
+      size_t w = MatchLeft(adjacency_[current_arc_[u]]);
+      if (w == kNoMatch) {
+        for (auto it = stack_.begin(); it != stack_.end(); it++) {
+          matched_arc_[*it] = current_arc_[*it];
+          match_right_[adjacency_[current_arc_[*it]]] = *it;
+        }
+        return true;
+      }
+      if (distance_[w] != kNoMatch && distance_[w] == distance_[u] + 1) {
+        stack_.push_back(w);
+      }
+      else {
+        current_arc_[u] += 1;
+      }
+    }
+    return false;
+  }
+};
+
+}
+
+#endif
@@ -1,23 +1,42 @@
 #ifndef _MAXFLOW_H
 #define _MAXFLOW_H
 
-#include <Python.h>
 #include <vector>
 #include <algorithm>
-#include <list>
 #include <limits>
 #include <deque>
 #include <iostream>
+#include <chrono>
+#include <string>
 
+#include "bfs.h"
 #include "graph.h"
+#include "matching.h"
+#include "parallel.h"
+#include "reorder.h"
+#include "selection.h"
+#include "trace.h"
 #include "utils.h"
 
+#ifdef CMAXFLOW_WITH_PYTHON
+#include <Python.h>
+#endif
+
 //#define MAXFLOW_VERBOSE
 
 namespace cmaxflow {
 
 template <typename FlowType> class MaxflowGraph;
 
+// Result of the last MaxPreFlow call.
+enum SolveStatus {
+  kOptimal = 0,               // maximum preflow found
+  kThresholdReached = 1,      // flow value >= threshold
+  kThresholdUnreachable = 2,  // upper bound < threshold
+  kTimeLimit = 3,
+  kWorkLimit = 4
+};
+
 typedef MaxflowGraph<double> MaxflowGraphDouble;
 typedef MaxflowGraph<int> MaxflowGraphInt;
 
@@ -30,16 +49,124 @@ public:
 
   //bool FromEdgeList(std::vector<std::pair<int, int>> edge_list,
   //  std::vector<FlowType> capacities, bool check_edge_redundancy);
-  bool FromPyObject(PyObject* p, bool check_edge_redundancy);
+  // Nodes in node_capacities (name, capacity) can pass at most that much
+  // flow. They are split internally; results are reported by original names.
+  bool FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+    const std::vector<FlowType>& capacities,
+    const std::vector<FlowType>& reverse_capacities,
+    const std::vector<std::pair<int, FlowType>>& node_capacities,
+    bool check_edge_redundancy, unsigned int num_threads = 0);
+#ifdef CMAXFLOW_WITH_PYTHON
+  bool FromPyObject(PyObject* p, bool check_edge_redundancy,
+    unsigned int num_threads = 0);
+  bool FromPyObject(PyObject* p,
+    const std::vector<std::pair<int, FlowType>>& node_capacities,
+    bool check_edge_redundancy, unsigned int num_threads = 0);
+#endif
   //bool SetSourceSink(PyObject* s, PyObject* t);
   bool SetSourceSink(int s, int t);
+
+  // Share the graph with other processes through POSIX shared memory.
+  // Flows, heights and buckets stay private to each MaxflowGraph.
+  bool ExportShared(const char* name) { return graph_.ExportShared(name); }
+  bool AttachShared(const char* name);
   //bool SetTol(PyObject* tol);
 
-  FlowType MaxPreFlow(unsigned int global_relabel_frequency, FlowType tol);
+  // Huge pages and NUMA placement of the graph (see Graph::SetAllocationPolicy).
+  // Must be called before building.
+  bool SetAllocationPolicy(int pages, int numa, unsigned int num_threads = 0);
+  AllocationReport GetAllocationReport() { return graph_.GetAllocationReport(); }
+
+  // Renumber nodes for memory locality (see ReorderMethod).
+  // Must be called after SetSourceSink. Results are reported by node names,
+  // so they do not depend on the order.
+  bool ReorderNodes(int method, unsigned int num_threads = 1);
+
+  // selection is one of SelectionRule (highest label by default).
+  FlowType MaxPreFlow(unsigned int global_relabel_frequency, FlowType tol,
+    int selection = kHighestLabel);
   void MinCut();
 
-  //PyObject* ToPythonResidualGraph();
-  PyObject* ToPythonMinCut();
+  // Threads of the breadth-first searches of GlobalRelabeling, MinCut,
+  // SourceSideMinCut and GlobalMinCut (0 = all hardware threads, 1 by default).
+  void SetNumThreads(unsigned int num_threads) { num_threads_ = num_threads; }
+
+  // Fast path for unit-capacity bipartite matching graphs: every edge with
+  // positive capacity is s -> u, u -> v or v -> t with capacity 1, and each
+  // u (v) has only the edge from s (to t). Solve the problem by
+  // Hopcroft-Karp and set the flows as MaxPreFlow would, so that MinCut and
+  // ToPythonMinCut can be used. Return false if the graph has another form.
+  bool BipartiteMatching(FlowType tol);
+  const std::vector<std::pair<int, int>>& GetMatching() { return matching_; }
+#ifdef CMAXFLOW_WITH_PYTHON
+  PyObject* ToPythonMatching();
+#endif
+
+  // Early exit of MaxPreFlow. The solver stops as soon as it knows whether
+  // the flow value reaches flow_threshold (<= 0 disables the threshold), or
+  // when time_limit seconds / work_limit edge scans are spent (0 disables).
+  // After an early exit, MaxPreFlow returns a lower bound, GetUpperBound an
+  // upper bound, and MinCut gives the cut proving the upper bound.
+  void SetFlowThreshold(FlowType flow_threshold);
+  void SetBudget(double time_limit, unsigned long long work_limit);
+  int GetStatus() { return status_; }
+  FlowType GetUpperBound() { return upper_bound_; }
+
+  // Record spans of the build and solver phases (see trace.h).
+  void EnableTrace(size_t capacity) { tracer_.Enable(capacity); }
+  void DisableTrace() { tracer_.Disable(); }
+  std::string ToChromeTrace() { return tracer_.ToChromeTrace(); }
+#ifdef CMAXFLOW_WITH_PYTHON
+  PyObject* ToPythonTrace();
+#endif
+
+  // Residual graph after MaxPreFlow in CSR form: out-edges of the node with
+  // index i are GetEdges()[GetOffsets()[i] .. GetOffsets()[i + 1]).
+  // The pointers are valid until the graph is rebuilt or reordered.
+  size_t GetNodeNumber() { return graph_.GetNodeNumber(); }
+  size_t GetEdgeNumber() { return graph_.GetEdgeNumber(); }
+  int GetNodeName(size_t index) { return graph_.GetNode(index)->name; }
+  // Name of the node a row belongs to: the out-copy of a node with a
+  // capacity maps back to that node (see IsOutCopy).
+  int GetOriginalName(size_t index) {
+    return graph_.GetInCopy(graph_.GetNode(index))->name;
+  }
+  const size_t* GetOffsets() { return graph_.GetOffsets(); }
+  const Edge<FlowType>* GetEdges() { return graph_.GetEdges(); }
+  // residuals[e] = capacity - flow of the e-th edge
+  void GetResiduals(FlowType* residuals);
+
+  // Nodes reachable from the source in the residual graph, extended to the
+  // nodes with excess (which a maximum flow would return to the source).
+  // Its complement is the sink side of the min cut with the smallest source
+  // side; MinCut gives the one with the largest source side.
+  void SourceSideMinCut();
+
+  // Side of the node with the given index in the cut of MinCut, or of
+  // SourceSideMinCut if minimal_source_side.
+  bool IsOnSourceSide(size_t index, bool minimal_source_side = false);
+  // True for the internal out-copy of a node with a capacity.
+  bool IsOutCopy(size_t index) { return graph_.IsOutCopy(graph_.GetNode(index)); }
+
+#ifdef CMAXFLOW_WITH_PYTHON
+  // minimal_source_side selects the cut of SourceSideMinCut instead of MinCut.
+  PyObject* ToPythonMinCut(bool minimal_source_side = false);
+  // Nodes whose capacity is in the minimum cut.
+  PyObject* ToPythonCutNodes();
+#endif
+
+  // Global minimum cut of the directed graph: the cut (S, T) of smallest
+  // capacity over all nonempty S and T, regardless of the source and sink.
+  // Found by two Hao-Orlin runs (one on the reversed graph), each within the
+  // time bound of one push-relabel max flow instead of n - 1 of them.
+  // Overwrites the flows, so MaxPreFlow must be called again before MinCut.
+  // Return false for graphs with node capacities or less than two nodes.
+  bool GlobalMinCut(FlowType tol);
+  FlowType GetGlobalCutValue() { return global_cut_value_; }
+  bool IsOnGlobalCutSourceSide(size_t index) { return global_cut_source_side_[index]; }
+#ifdef CMAXFLOW_WITH_PYTHON
+  PyObject* ToPythonGlobalMinCut();
+#endif
 
 private:
   Graph<FlowType> graph_;
@@ -54,27 +181,86 @@ private:
   FlowType flow_value_;
   bool done_mincut_;
   std::vector<bool> reacheable_from_sink_;
+  bool done_source_side_mincut_;
+  std::vector<bool> reacheable_from_source_;
+  // Matched (u, v) names of the last BipartiteMatching call
+  std::vector<std::pair<int, int>> matching_;
+
+  FlowType flow_threshold_;
+  double time_limit_;
+  unsigned long long work_limit_;
+  unsigned long long work_;
+  int status_;
+  FlowType upper_bound_;
+  // Excess pushed out of the source, and excess left at nodes with
+  // height >= n, which cannot reach the sink any more.
+  FlowType source_excess_;
+  FlowType stranded_excess_;
+  std::chrono::steady_clock::time_point deadline_;
+  Tracer tracer_;
+  int CheckStopCriteria(unsigned long long iteration);
+  FlowType CutCapacity();
 
   FlowType tol_;
   bool IsClose(FlowType a, FlowType b) {
     return isclose<FlowType>(a, b, tol_);
   }
 
-  std::vector<std::list<Node<FlowType>*>> active_nodes_;
-  std::vector<std::list<Node<FlowType>*>> inactive_nodes_;
+  std::vector<NodeBucket<FlowType>> active_nodes_;
+  std::vector<NodeBucket<FlowType>> inactive_nodes_;
   int max_height_;
+  // Activation order for the queue-based selection policies
+  std::deque<Node<FlowType>*> selection_queue_;
 
   void InitNodes();
   void InitFlows();
   void InitBuckets();
-  void Discharge(Node<FlowType>* node);
-  void Push(Edge<FlowType>* edge, FlowType amount);
+  template <typename Selection> FlowType RunMaxPreFlow();
+  template <typename Selection> void Discharge(Node<FlowType>* node);
+  template <typename Selection> void Push(const Edge<FlowType>* edge, FlowType amount);
   bool Relabel(Node<FlowType>* node);
   void GapHeuristic(int height);
 
   unsigned int global_relabel_counter_;
   unsigned int global_relabel_threshold_;
-  void GlobalRelabeling();
+  template <typename Selection> void GlobalRelabeling();
+
+  unsigned int num_threads_;
+  FrontierBfs<FlowType> bfs_;
+  // Threads of bfs_ and of the bucket rebuild, kept between relabelings
+  ThreadPool pool_;
+  // Breadth-first search from the sink in the reverse residual graph
+  void SinkBfs();
+
+  // Hao-Orlin state. Nodes are awake (the current sink side W, kept in the
+  // buckets), in the source set S (layer 0) or in a dormant set (layer > 0),
+  // which is woken, last in first out, when W becomes empty.
+  enum { kAwake = -1 };
+  bool done_global_mincut_;
+  FlowType global_cut_value_;
+  std::vector<bool> global_cut_source_side_;
+  bool reversed_residuals_;
+  std::vector<int> layer_;
+  std::vector<std::vector<Node<FlowType>*>> dormant_sets_;
+  Node<FlowType>* global_sink_;
+  size_t awake_number_;
+  int max_awake_height_;
+  // Indices of the nodes that left or joined W, in order, to rebuild the
+  // best cut without copying W at every improvement
+  std::vector<size_t> awake_changes_;
+  FlowType HaoOrlin(bool reversed, FlowType upper_bound, std::vector<bool>* source_side);
+  // Residual capacity in the graph, or the reversed graph during the second run
+  FlowType HaoOrlinResidual(const Edge<FlowType>* edge) {
+    const Edge<FlowType>* capacity_edge = reversed_residuals_ ? graph_.GetReversedEdge(edge) : edge;
+    return capacity_edge->capacity - graph_.GetFlow(edge);
+  }
+  void HaoOrlinPush(const Edge<FlowType>* edge, FlowType amount);
+  bool HaoOrlinRelabel(Node<FlowType>* node);
+  void HaoOrlinDischarge(Node<FlowType>* node);
+  void HaoOrlinInsert(Node<FlowType>* node);
+  void HaoOrlinGlobalRelabeling();
+  void HaoOrlinSleep(Node<FlowType>* node, size_t layer);
+  void HaoOrlinSaturate(Node<FlowType>* node);
 
 };
 
@@ -82,31 +268,86 @@ private:
 // Implementation
 
 template <typename FlowType>
-MaxflowGraph<FlowType>::MaxflowGraph() {
-  graph_ = Graph<FlowType>();
+MaxflowGraph<FlowType>::MaxflowGraph() : graph_() {
+  flow_threshold_ = 0;
+  time_limit_ = 0;
+  work_limit_ = 0;
+  status_ = kOptimal;
+  source_index_ = 0;
+  sink_index_ = 0;
   done_maxflow_ = false;
   done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  global_cut_value_ = 0;
+  reversed_residuals_ = false;
+  num_threads_ = 1;
 }
 
 template <typename FlowType>
-MaxflowGraph<FlowType>::MaxflowGraph(size_t max_node_num) {
-  graph_ = Graph<FlowType>(max_node_num);
+MaxflowGraph<FlowType>::MaxflowGraph(size_t max_node_num) : graph_(max_node_num) {
+  flow_threshold_ = 0;
+  time_limit_ = 0;
+  work_limit_ = 0;
+  status_ = kOptimal;
+  source_index_ = 0;
+  sink_index_ = 0;
   done_maxflow_ = false;
   done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  global_cut_value_ = 0;
+  reversed_residuals_ = false;
+  num_threads_ = 1;
 }
 
 template <typename FlowType>
 MaxflowGraph<FlowType>::~MaxflowGraph() {}
 
 template <typename FlowType>
-bool MaxflowGraph<FlowType>::FromPyObject(PyObject* p, bool check_edge_redundancy){
-  if (!graph_.FromPyObject(p, check_edge_redundancy)) {
+bool MaxflowGraph<FlowType>::FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+  const std::vector<FlowType>& capacities,
+  const std::vector<FlowType>& reverse_capacities,
+  const std::vector<std::pair<int, FlowType>>& node_capacities,
+  bool check_edge_redundancy, unsigned int num_threads) {
+  TraceSpan span(&tracer_, "Build");
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  if (!graph_.FromEdgeList(edge_list, capacities, reverse_capacities, node_capacities,
+      check_edge_redundancy, num_threads)) {
+    return false;
+  }
+  span.SetArg((long long) graph_.GetEdgeNumber());
+  return true;
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::FromPyObject(PyObject* p, bool check_edge_redundancy,
+  unsigned int num_threads){
+  return FromPyObject(p, std::vector<std::pair<int, FlowType>>(),
+    check_edge_redundancy, num_threads);
+}
+
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::FromPyObject(PyObject* p,
+  const std::vector<std::pair<int, FlowType>>& node_capacities,
+  bool check_edge_redundancy, unsigned int num_threads){
+  std::vector<std::pair<int, int>> edge_list;
+  std::vector<FlowType> capacities;
+  std::vector<FlowType> reverse_capacities;
+  if (!py_list_to_edge_list(p, &edge_list, &capacities, &reverse_capacities)) {
+    std::cerr << "Failed to convert a Python object to vectors." << std::endl;
     return false;
   }
   //source_index_ = graph_.GetNodeByName(s_name)->index;
   //sink_index_ = graph_.GetNodeByName(t_name)->index;
-  return true;
+  return FromEdgeList(edge_list, capacities, reverse_capacities, node_capacities,
+    check_edge_redundancy, num_threads);
 }
+#endif
 
 /*
 template <typename FlowType>
@@ -138,13 +379,134 @@ bool MaxflowGraph<FlowType>::SetSourceSink(int s, int t) {
     std::cerr << "Warning: source or sink node are not found in graph." << std::endl;
     return false;
   }
+  else if (graph_.IsOutCopy(source) || graph_.IsOutCopy(sink)) {
+    // Out-copy names are internal aliases of the nodes with a capacity.
+    std::cerr << "Warning: source or sink node are not found in graph." << std::endl;
+    return false;
+  }
   else {
-    source_index_ = source->index;
+    // Flow leaves a split source from its out-copy and enters a split sink
+    // at its in-copy, so their own capacities do not apply.
+    source_index_ = graph_.GetOutCopy(source)->index;
     sink_index_ = sink->index;
     return true;
   }
 }
 
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::AttachShared(const char* name) {
+  TraceSpan span(&tracer_, "AttachShared");
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  return graph_.AttachShared(name);
+}
+
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::SetAllocationPolicy(int pages, int numa, unsigned int num_threads) {
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  if (!graph_.SetAllocationPolicy(pages, numa, num_threads)) {
+    return false;
+  }
+  // Keep the solver threads on the CPUs that placed the pages.
+  pool_.SetPinned(numa == kFirstTouch && MultipleNumaNodes());
+  return true;
+}
+
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::ReorderNodes(int method, unsigned int num_threads) {
+  if (source_index_ == sink_index_) {
+    std::cerr << "Warning: ReorderNodes must be called after SetSourceSink." << std::endl;
+    return false;
+  }
+  std::vector<size_t> new_index;
+  switch (method) {
+    case kNoReorder:
+      return true;
+    case kBfsReorder:
+      new_index = BfsOrder(&graph_, sink_index_);
+      break;
+    case kRcmReorder:
+      new_index = RcmOrder(&graph_);
+      break;
+    case kDegreeReorder:
+      new_index = DegreeOrder(&graph_);
+      break;
+    default:
+      std::cerr << "Warning: unknown reorder method " << method << "." << std::endl;
+      return false;
+  }
+  if (!graph_.Reorder(new_index, num_threads)) {
+    return false;
+  }
+  source_index_ = new_index[source_index_];
+  sink_index_ = new_index[sink_index_];
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  return true;
+}
+
+template <typename FlowType>
+void MaxflowGraph<FlowType>::SetFlowThreshold(FlowType flow_threshold) {
+  flow_threshold_ = flow_threshold;
+}
+
+template <typename FlowType>
+void MaxflowGraph<FlowType>::SetBudget(double time_limit, unsigned long long work_limit) {
+  time_limit_ = time_limit;
+  work_limit_ = work_limit;
+}
+
+// Return the reason to stop the main loop, or kOptimal to continue.
+// The clock is read every 64 iterations.
+template <typename FlowType>
+int MaxflowGraph<FlowType>::CheckStopCriteria(unsigned long long iteration) {
+  if (flow_threshold_ > 0) {
+    FlowType sink_excess = graph_.GetNode(sink_index_)->excess;
+    if (sink_excess > flow_threshold_ || IsClose(sink_excess, flow_threshold_)) {
+      return kThresholdReached;
+    }
+    FlowType bound = source_excess_ - stranded_excess_;
+    if (bound < flow_threshold_ && !IsClose(bound, flow_threshold_)) {
+      return kThresholdUnreachable;
+    }
+  }
+  if (work_limit_ > 0 && work_ >= work_limit_) {
+    return kWorkLimit;
+  }
+  if (time_limit_ > 0 && iteration % 64 == 0
+      && std::chrono::steady_clock::now() >= deadline_) {
+    return kTimeLimit;
+  }
+  return kOptimal;
+}
+
+// Capacity of the cut between the nodes that can reach the sink in the
+// residual graph and the others (computed by MinCut).
+template <typename FlowType>
+FlowType MaxflowGraph<FlowType>::CutCapacity() {
+  FlowType capacity = 0;
+  size_t n = graph_.GetNodeNumber();
+  for (size_t i = 0; i < n; i++) {
+    if (reacheable_from_sink_[i]) {
+      continue;
+    }
+    for (size_t j = 0; j < graph_.GetOutEdgeNumber(i); j++) {
+      const Edge<FlowType>* edge = graph_.GetEdge(i, j);
+      if (reacheable_from_sink_[edge->dst]) {
+        capacity += edge->capacity;
+      }
+    }
+  }
+  return capacity;
+}
+
 // Initialize some node information:
 template <typename FlowType>
 void MaxflowGraph<FlowType>::InitNodes() {
@@ -172,108 +534,162 @@ void MaxflowGraph<FlowType>::InitNodes() {
 
 template <typename FlowType>
 void MaxflowGraph<FlowType>::InitBuckets() {
+  // Buckets are cleared in place to keep their storage between relabelings.
   size_t n = graph_.GetNodeNumber();
-  active_nodes_.clear();
-  inactive_nodes_.clear();
-  active_nodes_.reserve(n);
-  inactive_nodes_.reserve(n);
+  TraceSpan span(&tracer_, "InitBuckets", (long long) n);
+  active_nodes_.resize(n);
+  inactive_nodes_.resize(n);
   for (size_t i = 0; i < n; i++) {
-    active_nodes_.push_back(std::list<Node<FlowType>*>());
-    inactive_nodes_.push_back(std::list<Node<FlowType>*>());
+    active_nodes_[i].clear();
+    inactive_nodes_[i].clear();
   }
 }
 
 // Initialize preflows by zero
 template <typename FlowType>
 void MaxflowGraph<FlowType>::InitFlows() {
-  size_t n = graph_.GetNodeNumber();
-  for (size_t i = 0; i < n; i++) {
-    for (size_t j = 0; j < graph_.GetOutEdgeNumber(i); j++) {
-      Edge<FlowType>* edge = graph_.GetEdge(i, j);
-      edge->flow = 0;
-    }
-  }
+  graph_.ClearFlows();
 }
 
 template <typename FlowType>
-FlowType MaxflowGraph<FlowType>::MaxPreFlow(unsigned int global_relabel_frequency, FlowType tol) {
+FlowType MaxflowGraph<FlowType>::MaxPreFlow(unsigned int global_relabel_frequency, FlowType tol,
+  int selection) {
   tol_ = tol;
   global_relabel_counter_ = 0;
   if (global_relabel_frequency == 0) {
-    global_relabel_threshold_ = std::numeric_limits<FlowType>::max();
+    global_relabel_threshold_ = std::numeric_limits<unsigned int>::max();
   }
   else {
     unsigned int nm = (unsigned int) (graph_.GetNodeNumber() + graph_.GetEdgeNumber());
     global_relabel_threshold_ = nm / global_relabel_frequency;
   }
 
+  switch (selection) {
+    case kFifo:
+      return RunMaxPreFlow<FifoSelection>();
+    case kLifo:
+      return RunMaxPreFlow<LifoSelection>();
+    case kHighestLabel:
+      return RunMaxPreFlow<HighestLabelSelection>();
+    default:
+      std::cerr << "Warning: unknown selection rule " << selection
+      << ", using the highest label rule." << std::endl;
+      return RunMaxPreFlow<HighestLabelSelection>();
+  }
+}
+
+template <typename FlowType>
+template <typename Selection>
+FlowType MaxflowGraph<FlowType>::RunMaxPreFlow() {
+  TraceSpan span(&tracer_, "MaxPreFlow");
   // Init nodes and edges
   InitBuckets();
   InitNodes();
   InitFlows();
+  selection_queue_.clear();
+  int n = (int) graph_.GetNodeNumber();
+  work_ = 0;
+  status_ = kOptimal;
+  bool has_stop_criteria = flow_threshold_ > 0 || time_limit_ > 0 || work_limit_ > 0;
+  if (time_limit_ > 0) {
+    deadline_ = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(time_limit_));
+  }
 
 
   // Push all edges from source
+  source_excess_ = 0;
+  stranded_excess_ = 0;
   for (size_t i = 0; i < graph_.GetOutEdgeNumber(source_index_); i++) {
-    Edge<FlowType>* edge = graph_.GetEdge(source_index_, i);
-    FlowType res = edge->capacity - edge->flow;
+    const Edge<FlowType>* edge = graph_.GetEdge(source_index_, i);
+    FlowType res = graph_.GetResidual(edge);
     if (res > 0 && !IsClose(res, 0)) {
-      Push(edge, res);
+      Push<Selection>(edge, res);
+      source_excess_ += res;
     }
   }
 
+  // Discharges between two global relabelings are traced as one span.
+  uint64_t streak_start_ns = tracer_.enabled() ? tracer_.Now() : 0;
+  unsigned long long streak_start = 0;
+  auto trace_streak = [&](unsigned long long iteration) {
+    if (tracer_.enabled()) {
+      uint64_t now = tracer_.Now();
+      tracer_.Record("Discharge", streak_start_ns, now, (long long) (iteration - streak_start));
+      streak_start_ns = now;
+      streak_start = iteration;
+    }
+  };
+
   // Main loop
-  while (true) {
+  unsigned long long iteration = 0;
+  for (; ; iteration++) {
+    if (has_stop_criteria) {
+      status_ = CheckStopCriteria(iteration);
+      if (status_ != kOptimal) {
+        break;
+      }
+    }
+
     // Global relabeling
     if (global_relabel_counter_ > global_relabel_threshold_) {
-      GlobalRelabeling();
+      trace_streak(iteration);
+      GlobalRelabeling<Selection>();
       global_relabel_counter_ = 0;
+      if (tracer_.enabled()) {
+        streak_start_ns = tracer_.Now();
+      }
     }
 
     // Pop an active node to discharge
     // If there is no active node, then stop.
-    while (max_height_ >= 0 && active_nodes_[max_height_].empty()) {
-      max_height_ -= 1;
-    }
-    if (max_height_ < 0) {
+    Node<FlowType>* node = Selection::Next(&selection_queue_, &active_nodes_, &max_height_, n);
+    if (node == nullptr) {
       #ifdef MAXFLOW_VERBOSE
       std::cout << "Done!" << std::endl;
       #endif
       break;
     }
-    Node<FlowType>* node = active_nodes_[max_height_].back();
-    active_nodes_[max_height_].pop_back();
 
     // Discharge node
-    Discharge(node);
+    Discharge<Selection>(node);
   }
+  trace_streak(iteration);
   done_maxflow_ = true;
   flow_value_ = graph_.GetNode(sink_index_)->excess;
+  upper_bound_ = flow_value_;
+  if (status_ != kOptimal) {
+    // The sink excess is a lower bound; the cut between the nodes that can
+    // still reach the sink and the others gives an upper bound.
+    MinCut();
+    upper_bound_ = std::min(source_excess_ - stranded_excess_, CutCapacity());
+  }
   return flow_value_;
 }
 
 // Increase flow value of the given edge
 template <typename FlowType>
-void MaxflowGraph<FlowType>::Push(Edge<FlowType>* edge, FlowType amount) {
+template <typename Selection>
+void MaxflowGraph<FlowType>::Push(const Edge<FlowType>* edge, FlowType amount) {
   #ifdef MAXFLOW_VERBOSE
-  std::cout << "Pushing edge (" << edge->src->name << ", " << edge->dst->name << ")"
+  std::cout << "Pushing edge (" << graph_.GetSrc(edge)->name << ", " << graph_.GetDst(edge)->name << ")"
   << " (amount: "<< amount
-  << ", residual cap:" << edge->capacity - edge->flow << ")" << std::endl;
-  //std::cout << "[amount = " << amount << ", res = " << edge->capacity - edge->flow << "]" << std::endl;
+  << ", residual cap:" << graph_.GetResidual(edge) << ")" << std::endl;
   #endif
-  edge->flow += amount;
-  graph_.GetReversedEdge(edge)->flow -= amount;
+  graph_.GetFlow(edge) += amount;
+  graph_.GetFlow(graph_.GetReversedEdge(edge)) -= amount;
 
-  Node<FlowType>* src = edge->src;
+  Node<FlowType>* src = graph_.GetSrc(edge);
   src->excess -= amount;
 
-  Node<FlowType>* dst = edge->dst;
+  Node<FlowType>* dst = graph_.GetDst(edge);
   if (IsClose(dst->excess, 0) && IsInnerNode(dst)) {
-    // inactive_nodes_から削除してactive_nodes_に追加したいが，
-    // list内での現在の位置がわからないのでで O(1) ではできない．
-    // 今回の実装では諦めてlist内をサーチしてよいことにする
+    // Node::index_in_bucket gives the position in inactive_nodes_, so the
+    // move to active_nodes_ is O(1).
     inactive_nodes_[dst->height].remove(dst);
     active_nodes_[dst->height].push_back(dst);
+    Selection::Activate(&selection_queue_, dst);
     max_height_ = std::max(dst->height, max_height_);
     #ifdef MAXFLOW_VERBOSE
     std::cout << "node " << dst->name << " is activated "
@@ -301,11 +717,13 @@ bool MaxflowGraph<FlowType>::Relabel(Node<FlowType>* node) {
   #endif
   int n = (int) graph_.GetNodeNumber();
   global_relabel_counter_ += n;
+  work_ += graph_.GetOutEdgeNumber(node->index);
 
   int old_height = node->height;
   if (active_nodes_[old_height].size() == 0 && inactive_nodes_[old_height].size() == 0){
     GapHeuristic(old_height);
     node->height = n;
+    stranded_excess_ += node->excess;
     return false;
   }
 
@@ -313,11 +731,9 @@ bool MaxflowGraph<FlowType>::Relabel(Node<FlowType>* node) {
   int min_height = 2 * n;
   size_t min_edge_index = 0;
   for (size_t i = 0; i < graph_.GetOutEdgeNumber(node->index); i++) {
-    Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
-    int current_height = edge->dst->height;
-    FlowType res = edge->capacity - edge->flow;
-    //std::cout << "edge (" << node->name << ", " << edge->dst->name << ")"
-    //<< "flow: " << edge->flow << " cap: " << edge -> capacity << std::endl;
+    const Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
+    int current_height = graph_.GetDst(edge)->height;
+    FlowType res = graph_.GetResidual(edge);
     if (res > 0 && !IsClose(res, 0) && min_height > current_height) {
       min_height = current_height;
       min_edge_index = i;
@@ -329,24 +745,29 @@ bool MaxflowGraph<FlowType>::Relabel(Node<FlowType>* node) {
   std::cout << "Height of node " << node->name << " is changed: " << old_height
   << " -> " << node->height << std::endl;
   #endif
+  if (node->height >= n) {
+    stranded_excess_ += node->excess;
+  }
   return node->height < n;
 }
 
 template <typename FlowType>
+template <typename Selection>
 void MaxflowGraph<FlowType>::Discharge(Node<FlowType>* node) {
   #ifdef MAXFLOW_VERBOSE
   std::cout << "Discharging node " << node->name << " (height: " << node->height
   << ", excess: " << node->excess << ")" << std::endl;
   #endif
   while (true) {
-    Edge<FlowType>* current_edge = graph_.GetEdge(node->index, node->current_edge_idx);
-    FlowType res = current_edge->capacity - current_edge->flow;
+    work_ += 1;
+    const Edge<FlowType>* current_edge = graph_.GetEdge(node->index, node->current_edge_idx);
+    FlowType res = graph_.GetResidual(current_edge);
     if (res > 0 && !IsClose(res, 0)) {
-      Node<FlowType>* dst = current_edge->dst;
+      Node<FlowType>* dst = graph_.GetDst(current_edge);
       // tbc: current edge is admissible if dst->height + 1 == node->height
       if (dst->height <  node->height) {
         FlowType update = std::min(node->excess, res);
-        Push(current_edge, update);
+        Push<Selection>(current_edge, update);
         if (IsClose(node->excess, 0)) {
           break;
         }
@@ -366,6 +787,7 @@ void MaxflowGraph<FlowType>::Discharge(Node<FlowType>* node) {
   if (node->height < (int) graph_.GetNodeNumber()) {
     if (node->excess > 0 && !IsClose(node->excess, 0)) {
       active_nodes_[node->height].push_back(node);
+      Selection::Activate(&selection_queue_, node);
       max_height_ = std::max(node->height, max_height_);
       #ifdef MAXFLOW_VERBOSE
       std::cout << "node " << node->name << " is still active " <<
@@ -388,12 +810,14 @@ void MaxflowGraph<FlowType>::GapHeuristic(int height) {
   #ifdef MAXFLOW_VERBOSE
   std::cout << "Gap relabeling at height = " << height << std::endl;
   #endif
+  TraceSpan span(&tracer_, "GapHeuristic", height);
   int n = (int) graph_.GetNodeNumber();
 
   for (int h = height; h <= max_height_; h++) {
     for (auto node_it = active_nodes_[h].begin();
         node_it != active_nodes_[h].end(); node_it++) {
       (*node_it)->height = n;
+      stranded_excess_ += (*node_it)->excess;
     }
     active_nodes_[h].clear();
 
@@ -407,55 +831,87 @@ void MaxflowGraph<FlowType>::GapHeuristic(int height) {
 }
 
 template <typename FlowType>
+void MaxflowGraph<FlowType>::SinkBfs() {
+  // An edge u -> v can be followed back from v to u if it has a residual
+  // capacity. Top-down scans the out-edges of v, whose reversed edges are
+  // the edges u -> v.
+  const Edge<FlowType>* edges = graph_.GetEdges();
+  bfs_.Run(graph_.GetOffsets(), edges, graph_.GetNodeNumber(),
+    std::vector<size_t>(1, sink_index_), num_threads_, &pool_,
+    [&](size_t e) {
+      FlowType res_rev = graph_.GetResidual(edges + edges[e].reversed);
+      return res_rev > 0 && !IsClose(res_rev, 0);
+    },
+    [&](size_t e) {
+      FlowType res = graph_.GetResidual(edges + e);
+      return res > 0 && !IsClose(res, 0);
+    });
+}
+
+template <typename FlowType>
+template <typename Selection>
 void MaxflowGraph<FlowType>::GlobalRelabeling() {
   #ifdef MAXFLOW_VERBOSE
   std::cout << "Global update" << std::endl;
   #endif
-  std::deque<Node<FlowType>*> Q;
-  std::vector<bool> visited(graph_.GetNodeNumber(), false);
-
-  Node<FlowType>* sink = graph_.GetNode(sink_index_);
-  Q.push_back(sink);
-  visited[sink->index] = true;
+  TraceSpan span(&tracer_, "GlobalRelabeling");
+  SinkBfs();
   InitBuckets();
+  selection_queue_.clear();
 
-  while (!Q.empty()) { // start bfs
-    Node<FlowType>* node = Q.front();
-    Q.pop_front();
-    //std::cout << "node = " << node->name << std::endl;
-    int next_height = node->height + 1;
-
-    for (size_t i = 0; i < graph_.GetOutEdgeNumber(node->index); i++) {
-      Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
-      Edge<FlowType>* edge_rev = graph_.GetReversedEdge(edge);
-      FlowType res_rev = edge_rev->capacity - edge_rev->flow;
-      if (res_rev > 0 && !IsClose(res_rev, 0)) {
-        Node<FlowType>* next_node = edge->dst;
-        if (!visited[next_node->index]) {
-          visited[next_node->index] = true;
-          next_node->height = next_height;
-          if (next_node->excess > 0 && !IsClose(next_node->excess, 0)) {
-            active_nodes_[next_height].push_back(next_node);
-            max_height_ = std::max(next_height, max_height_);
+  // Heights are the exact distances to the sink; nodes that cannot reach it
+  // are lifted to n.
+  int n = (int) graph_.GetNodeNumber();
+  unsigned int num_threads = FrontierBfs<FlowType>::ThreadNumber(num_threads_,
+    n, graph_.GetEdgeNumber());
+  std::vector<FlowType> stranded(num_threads, 0);
+  pool_.For(n, num_threads, [&](unsigned int k, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      Node<FlowType>* node = graph_.GetNode(i);
+      int level = bfs_.Level(i);
+      if (level > 0) {
+        node->height = level;
+      }
+      if (IsInnerNode(node)) {
+        node->current_edge_idx = 0;
+        if (level < 0) {
+          node->height = n;
+          stranded[k] += node->excess;
+        }
+      }
+    }
+  });
+  stranded_excess_ = 0;
+  for (unsigned int k = 0; k < num_threads; k++) {
+    stranded_excess_ += stranded[k];
+  }
+
+  // Each level fills its own buckets.
+  size_t levels = bfs_.LevelNumber();
+  const std::vector<size_t>& order = bfs_.Order();
+  pool_.For(levels, std::min(num_threads, (unsigned int) levels),
+    [&](unsigned int, size_t begin, size_t end) {
+      for (size_t d = std::max(begin, (size_t) 1); d < end; d++) {
+        for (size_t i = bfs_.LevelBegin(d); i < bfs_.LevelBegin(d + 1); i++) {
+          Node<FlowType>* node = graph_.GetNode(order[i]);
+          if (node->excess > 0 && !IsClose(node->excess, 0)) {
+            active_nodes_[d].push_back(node);
           }
           else {
-            inactive_nodes_[next_height].push_back(next_node);
+            inactive_nodes_[d].push_back(node);
           }
-          Q.push_back(next_node);
         }
       }
-    }
-  } // end bfs
-  int n = (int) graph_.GetNodeNumber();
-  for (size_t i = 0; i < graph_.GetNodeNumber(); i++) {
-    Node<FlowType>* node = graph_.GetNode(i);
-    if (IsInnerNode(node)) {
-      node->current_edge_idx = 0;
-      if (!visited[i]) {
-        node->height = n;
+    });
+  for (size_t d = 1; d < levels; d++) {
+    if (!active_nodes_[d].empty()) {
+      max_height_ = std::max((int) d, max_height_);
+      for (auto node_it = active_nodes_[d].begin(); node_it != active_nodes_[d].end(); node_it++) {
+        Selection::Activate(&selection_queue_, *node_it);
       }
     }
   }
+  span.SetArg((long long) order.size());
 }
 
 template <typename FlowType>
@@ -467,46 +923,80 @@ void MaxflowGraph<FlowType>::MinCut() {
     #ifdef MAXFLOW_VERBOSE
     std::cout << "Calculate mincut" << std::endl;
     #endif
+    TraceSpan span(&tracer_, "MinCut");
     size_t n = graph_.GetNodeNumber();
-    reacheable_from_sink_.reserve(n);
+    SinkBfs();
     reacheable_from_sink_.assign(n, false);
+    for (size_t i = 0; i < n; i++) {
+      reacheable_from_sink_[i] = bfs_.Level(i) >= 0;
+    }
+    done_mincut_ = true;
+  }
+}
 
-    std::deque<Node<FlowType>*> Q;
-    std::vector<bool> visited(n, false);
-
-    Node<FlowType>* sink = graph_.GetNode(sink_index_);
-    Q.push_back(sink);
-    visited[sink_index_] = true;
-    reacheable_from_sink_[sink_index_] = true;
-
-    while (!Q.empty()) { //bfs
-      Node<FlowType>* node = Q.front();
-      Q.pop_front();
-      for (size_t i = 0; i < graph_.GetOutEdgeNumber(node->index); i++) {
-        Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
-        Edge<FlowType>* edge_rev = graph_.GetReversedEdge(edge);
-        FlowType res_rev = edge_rev->capacity - edge_rev->flow;
-        if (res_rev > 0 && !IsClose(res_rev, 0)) {
-          Node<FlowType>* next_node = edge->dst;
-          if (!visited[next_node->index]) {
-            visited[next_node->index] = true;
-            reacheable_from_sink_[next_node->index] = true;
-            Q.push_back(next_node);
-          }
-        }
-      }
-    }//bfs end
+template <typename FlowType>
+void MaxflowGraph<FlowType>::SourceSideMinCut() {
+  if (!done_maxflow_) {
+    std::cerr << "Warning: SourceSideMinCut must be called after MaxPreFlow." << std::endl;
+    return;
+  }
+  if (status_ != kOptimal) {
+    std::cerr << "Warning: the preflow is not maximum (early exit); "
+    "the source side is not a min cut." << std::endl;
+  }
+  TraceSpan span(&tracer_, "SourceSideMinCut");
+  size_t n = graph_.GetNodeNumber();
+  reacheable_from_source_.assign(n, false);
+  // Excess at a node came from the source along edges with positive flow,
+  // so returning it would make the node reachable from the source.
+  std::vector<size_t> roots;
+  for (size_t i = 0; i < n; i++) {
+    Node<FlowType>* node = graph_.GetNode(i);
+    if (i == source_index_ || (IsInnerNode(node) && node->excess > 0 && !IsClose(node->excess, 0))) {
+      roots.push_back(i);
+    }
+  }
+  const Edge<FlowType>* edges = graph_.GetEdges();
+  bfs_.Run(graph_.GetOffsets(), edges, n, roots, num_threads_, &pool_,
+    [&](size_t e) {
+      FlowType res = graph_.GetResidual(edges + e);
+      return res > 0 && !IsClose(res, 0);
+    },
+    [&](size_t e) {
+      FlowType res_rev = graph_.GetResidual(edges + edges[e].reversed);
+      return res_rev > 0 && !IsClose(res_rev, 0);
+    });
+  for (size_t i = 0; i < n; i++) {
+    reacheable_from_source_[i] = bfs_.Level(i) >= 0;
+  }
+  done_source_side_mincut_ = true;
+}
 
-    done_mincut_ = true;
+template <typename FlowType>
+void MaxflowGraph<FlowType>::GetResiduals(FlowType* residuals) {
+  size_t m = graph_.GetEdgeNumber();
+  const Edge<FlowType>* edges = graph_.GetEdges();
+  for (size_t e = 0; e < m; e++) {
+    residuals[e] = graph_.GetResidual(&edges[e]);
   }
 }
 
 template <typename FlowType>
-PyObject* MaxflowGraph<FlowType>::ToPythonMinCut(){
-  if (!done_mincut_) {
+bool MaxflowGraph<FlowType>::IsOnSourceSide(size_t index, bool minimal_source_side) {
+  return minimal_source_side ? reacheable_from_source_[index] : !reacheable_from_sink_[index];
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+template <typename FlowType>
+PyObject* MaxflowGraph<FlowType>::ToPythonMinCut(bool minimal_source_side){
+  if (!minimal_source_side && !done_mincut_) {
     std::cerr << "Warning: ToPythonMinCut must be called after MaxCut." << std::endl;
     return NULL;
   }
+  else if (minimal_source_side && !done_source_side_mincut_) {
+    std::cerr << "Warning: ToPythonMinCut must be called after SourceSideMinCut." << std::endl;
+    return NULL;
+  }
   else {
     #ifdef MAXFLOW_VERBOSE
     std::cout << "Convert to Python object" << std::endl;
@@ -515,8 +1005,13 @@ PyObject* MaxflowGraph<FlowType>::ToPythonMinCut(){
     PyObject* cut = PySet_New(NULL);
     PyObject* cut_c = PySet_New(NULL);
     for (size_t i = 0; i < n; i++) {
+      // A split node is on the side of its in-copy.
+      if (graph_.IsOutCopy(graph_.GetNode(i))) {
+        continue;
+      }
       int name = graph_.GetNode(i)->name;
-      if (reacheable_from_sink_[i]) {
+      bool sink_side = minimal_source_side ? !reacheable_from_source_[i] : reacheable_from_sink_[i];
+      if (sink_side) {
         PySet_Add(cut_c, PyLong_FromLong((long) name));
       }
       else {
@@ -534,6 +1029,548 @@ PyObject* MaxflowGraph<FlowType>::ToPythonMinCut(){
     return ret;
   }
 }
+#endif
+
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::BipartiteMatching(FlowType tol) {
+  TraceSpan span(&tracer_, "BipartiteMatching");
+  tol_ = tol;
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  matching_.clear();
+  size_t n = graph_.GetNodeNumber();
+  if (source_index_ == sink_index_) {
+    std::cerr << "Warning: BipartiteMatching must be called after SetSourceSink." << std::endl;
+    return false;
+  }
+
+  // Left nodes are the heads of the source edges and right nodes are the
+  // tails of the sink edges. The check below rejects every other edge.
+  const size_t kOther = std::numeric_limits<size_t>::max();
+  std::vector<size_t> left_index(n, kOther);
+  std::vector<size_t> right_index(n, kOther);
+  std::vector<const Edge<FlowType>*> source_edges;
+  std::vector<const Edge<FlowType>*> sink_edges;
+  size_t positive_edge_number = 0;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < graph_.GetOutEdgeNumber(i); j++) {
+      const Edge<FlowType>* edge = graph_.GetEdge(i, j);
+      if (edge->capacity <= 0 || IsClose(edge->capacity, 0)) {
+        continue;
+      }
+      positive_edge_number += 1;
+      if (!IsClose(edge->capacity, 1)) {
+        return false;
+      }
+      if (edge->src == source_index_ && edge->dst != sink_index_) {
+        if (left_index[edge->dst] != kOther) {
+          return false;
+        }
+        left_index[edge->dst] = source_edges.size();
+        source_edges.push_back(edge);
+      }
+      else if (edge->dst == sink_index_ && edge->src != source_index_) {
+        if (right_index[edge->src] != kOther) {
+          return false;
+        }
+        right_index[edge->src] = sink_edges.size();
+        sink_edges.push_back(edge);
+      }
+    }
+  }
+
+  // Collect the u -> v edges for each left node u.
+  std::vector<size_t> offsets(source_edges.size() + 1, 0);
+  std::vector<size_t> adjacency;
+  std::vector<const Edge<FlowType>*> middle_edges;
+  for (size_t k = 0; k < source_edges.size(); k++) {
+    size_t u = source_edges[k]->dst;
+    if (right_index[u] != kOther) {
+      return false;
+    }
+    for (size_t j = 0; j < graph_.GetOutEdgeNumber(u); j++) {
+      const Edge<FlowType>* edge = graph_.GetEdge(u, j);
+      if (edge->capacity <= 0 || IsClose(edge->capacity, 0)) {
+        continue;
+      }
+      if (right_index[edge->dst] == kOther) {
+        return false;
+      }
+      adjacency.push_back(right_index[edge->dst]);
+      middle_edges.push_back(edge);
+    }
+    offsets[k + 1] = adjacency.size();
+  }
+  // Any other positive edge (into the source, out of the sink, between
+  // right nodes, ...) is not counted above.
+  if (positive_edge_number != source_edges.size() + middle_edges.size() + sink_edges.size()) {
+    return false;
+  }
+
+  HopcroftKarp matcher(source_edges.size(), sink_edges.size(), offsets, adjacency);
+  size_t size = matcher.Solve();
+  span.SetArg((long long) size);
+
+  InitFlows();
+  for (size_t i = 0; i < n; i++) {
+    graph_.GetNode(i)->excess = 0;
+  }
+  auto push_unit = [&](const Edge<FlowType>* edge) {
+    graph_.GetFlow(edge) += 1;
+    graph_.GetFlow(graph_.GetReversedEdge(edge)) -= 1;
+  };
+  for (size_t k = 0; k < source_edges.size(); k++) {
+    size_t arc = matcher.MatchedArc(k);
+    if (arc == kNoMatch) {
+      continue;
+    }
+    const Edge<FlowType>* edge = middle_edges[arc];
+    push_unit(source_edges[k]);
+    push_unit(edge);
+    push_unit(sink_edges[adjacency[arc]]);
+    matching_.push_back(std::make_pair(graph_.GetSrc(edge)->name, graph_.GetDst(edge)->name));
+  }
+  graph_.GetNode(source_index_)->excess = -(FlowType) size;
+  graph_.GetNode(sink_index_)->excess = (FlowType) size;
+
+  done_maxflow_ = true;
+  flow_value_ = (FlowType) size;
+  status_ = kOptimal;
+  upper_bound_ = flow_value_;
+  return true;
+}
+
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::GlobalMinCut(FlowType tol) {
+  TraceSpan span(&tracer_, "GlobalMinCut");
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  done_source_side_mincut_ = false;
+  done_global_mincut_ = false;
+  size_t n = graph_.GetNodeNumber();
+  if (graph_.HasNodeCapacities()) {
+    std::cerr << "Warning: GlobalMinCut does not support node capacities." << std::endl;
+    return false;
+  }
+  if (n < 2) {
+    std::cerr << "Warning: GlobalMinCut needs at least two nodes." << std::endl;
+    return false;
+  }
+  tol_ = tol;
+
+  // Capacities are summed again, so that the value does not carry the
+  // excess left below tol.
+  auto cut_capacity = [&](const std::vector<bool>& source_side) {
+    FlowType capacity = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (!source_side[i]) {
+        continue;
+      }
+      for (size_t j = 0; j < graph_.GetOutEdgeNumber(i); j++) {
+        const Edge<FlowType>* edge = graph_.GetEdge(i, j);
+        if (!source_side[edge->dst]) {
+          capacity += edge->capacity;
+        }
+      }
+    }
+    return capacity;
+  };
+
+  // Hao-Orlin finds the best cut with the node of index 0 on the source
+  // side; the cuts with it on the sink side are the cuts of the reversed
+  // graph with it on the source side. The second run only needs the cuts
+  // below the first one.
+  std::vector<bool> forward_side;
+  std::vector<bool> backward_side;
+  HaoOrlin(false, std::numeric_limits<FlowType>::max(), &forward_side);
+  FlowType forward_value = cut_capacity(forward_side);
+  HaoOrlin(true, forward_value, &backward_side);
+  reversed_residuals_ = false;
+  backward_side.flip();
+  FlowType backward_value = cut_capacity(backward_side);
+  if (backward_value < forward_value) {
+    global_cut_value_ = backward_value;
+    global_cut_source_side_.swap(backward_side);
+  }
+  else {
+    global_cut_value_ = forward_value;
+    global_cut_source_side_.swap(forward_side);
+  }
+  done_global_mincut_ = true;
+  return true;
+}
+
+// One Hao-Orlin run (Hao and Orlin, 1994). The source set S grows by one
+// node per phase: the sink t, the awake node with the smallest height,
+// receives the maximum preflow from the other nodes, which gives the best
+// cut with S on the source side and t on the sink side; then t joins S.
+// Nodes that cannot reach t (found by the gap rule or by a relabel without
+// awake neighbors) wait in dormant sets, so the heights are never reset.
+// Cuts of at least upper_bound may be skipped. Returns the smallest excess
+// of t and the source side of that cut.
+template <typename FlowType>
+FlowType MaxflowGraph<FlowType>::HaoOrlin(bool reversed, FlowType upper_bound,
+  std::vector<bool>* source_side) {
+  TraceSpan span(&tracer_, "HaoOrlin", reversed ? 1 : 0);
+  size_t n = graph_.GetNodeNumber();
+  reversed_residuals_ = reversed;
+  InitBuckets();
+  InitFlows();
+  layer_.assign(n, kAwake);
+  dormant_sets_.assign(1, std::vector<Node<FlowType>*>());
+  awake_changes_.clear();
+  awake_number_ = n;
+  // Global relabelings cost about as much as the relabels between them
+  global_relabel_counter_ = 0;
+  global_relabel_threshold_ = (unsigned int) (n + graph_.GetEdgeNumber());
+  max_height_ = -1;
+  max_awake_height_ = 0;
+  for (size_t i = 0; i < n; i++) {
+    Node<FlowType>* node = graph_.GetNode(i);
+    node->excess = 0;
+    node->height = 0;
+    node->current_edge_idx = 0;
+  }
+  Node<FlowType>* source = graph_.GetNode(0);
+  HaoOrlinSleep(source, 0);
+  for (size_t i = 1; i < n; i++) {
+    inactive_nodes_[0].push_back(graph_.GetNode(i));
+  }
+  global_sink_ = graph_.GetNode(1);
+
+  FlowType best_value = std::numeric_limits<FlowType>::max();
+  size_t best_changes = 0;
+  while (true) {
+    HaoOrlinSaturate(source);
+
+    // Awake nodes are not below the sink, whose height grows every phase.
+    Node<FlowType>* node;
+    while ((node = HighestLabelSelection::Next(&selection_queue_, &active_nodes_,
+        &max_height_, (int) n, global_sink_->height)) != nullptr) {
+      // Excess detection (Chekuri et al., 1997): a cut with S on the source
+      // side and node on the sink side carries at least the excess of node,
+      // so node can join S once that excess reaches the best cut. Otherwise
+      // the excess stuck in W would be discharged again in every phase.
+      if (node->excess >= std::min(best_value, upper_bound)) {
+        HaoOrlinSleep(node, 0);
+        HaoOrlinSaturate(node);
+        continue;
+      }
+      HaoOrlinDischarge(node);
+      if (global_relabel_counter_ > global_relabel_threshold_) {
+        HaoOrlinGlobalRelabeling();
+        global_relabel_counter_ = 0;
+      }
+    }
+    if (global_sink_->excess < best_value) {
+      best_value = global_sink_->excess;
+      best_changes = awake_changes_.size();
+    }
+
+    // Move the sink to S
+    source = global_sink_;
+    inactive_nodes_[source->height].remove(source);
+    HaoOrlinSleep(source, 0);
+
+    // Choose the next sink, waking the last dormant set if W is empty
+    if (awake_number_ == 0) {
+      if (dormant_sets_.size() == 1) {
+        break;
+      }
+      std::vector<Node<FlowType>*> woken;
+      woken.swap(dormant_sets_.back());
+      dormant_sets_.pop_back();
+      global_sink_ = woken[0];
+      for (auto it = woken.begin(); it != woken.end(); it++) {
+        if ((*it)->height < global_sink_->height) {
+          global_sink_ = *it;
+        }
+      }
+      max_awake_height_ = 0;
+      for (auto it = woken.begin(); it != woken.end(); it++) {
+        layer_[(*it)->index] = kAwake;
+        awake_number_ += 1;
+        awake_changes_.push_back((*it)->index);
+        (*it)->current_edge_idx = 0;
+        HaoOrlinInsert(*it);
+      }
+    }
+    else {
+      // Heights do not decrease, so no awake node is below the old sink.
+      int height = source->height;
+      while (active_nodes_[height].empty() && inactive_nodes_[height].empty()) {
+        height += 1;
+      }
+      if (!inactive_nodes_[height].empty()) {
+        global_sink_ = inactive_nodes_[height].back();
+      }
+      else {
+        global_sink_ = active_nodes_[height].back();
+        active_nodes_[height].pop_back();
+        inactive_nodes_[height].push_back(global_sink_);
+      }
+    }
+  }
+
+  // W of the best phase: all nodes, less the changes made before it
+  std::vector<bool> awake(n, true);
+  for (size_t k = 0; k < best_changes; k++) {
+    awake[awake_changes_[k]] = !awake[awake_changes_[k]];
+  }
+  source_side->assign(n, false);
+  for (size_t i = 0; i < n; i++) {
+    (*source_side)[i] = !awake[i];
+  }
+  return best_value;
+}
+
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinPush(const Edge<FlowType>* edge, FlowType amount) {
+  graph_.GetFlow(edge) += amount;
+  graph_.GetFlow(graph_.GetReversedEdge(edge)) -= amount;
+  graph_.GetSrc(edge)->excess -= amount;
+
+  // Dormant nodes keep their excess until they are woken.
+  Node<FlowType>* dst = graph_.GetDst(edge);
+  if (layer_[dst->index] == kAwake && dst != global_sink_ && IsClose(dst->excess, 0)) {
+    inactive_nodes_[dst->height].remove(dst);
+    active_nodes_[dst->height].push_back(dst);
+    max_height_ = std::max(dst->height, max_height_);
+  }
+  dst->excess += amount;
+}
+
+// Relabel as MaxflowGraph::Relabel, where only awake nodes count. Instead of
+// reaching height n, the nodes cut off from the sink become a dormant set:
+// node and the awake nodes above it if node was alone at its height (gap),
+// or node alone if it has no residual edge to an awake node. Then return
+// false.
+template <typename FlowType>
+bool MaxflowGraph<FlowType>::HaoOrlinRelabel(Node<FlowType>* node) {
+  global_relabel_counter_ += (unsigned int) graph_.GetOutEdgeNumber(node->index);
+  int old_height = node->height;
+  if (active_nodes_[old_height].empty() && inactive_nodes_[old_height].empty()) {
+    TraceSpan span(&tracer_, "GapHeuristic", old_height);
+    dormant_sets_.push_back(std::vector<Node<FlowType>*>());
+    size_t layer = dormant_sets_.size() - 1;
+    HaoOrlinSleep(node, layer);
+    for (int h = old_height + 1; h <= max_awake_height_; h++) {
+      for (auto node_it = active_nodes_[h].begin(); node_it != active_nodes_[h].end(); node_it++) {
+        HaoOrlinSleep(*node_it, layer);
+      }
+      active_nodes_[h].clear();
+      for (auto node_it = inactive_nodes_[h].begin(); node_it != inactive_nodes_[h].end(); node_it++) {
+        HaoOrlinSleep(*node_it, layer);
+      }
+      inactive_nodes_[h].clear();
+    }
+    max_awake_height_ = old_height - 1;
+    max_height_ = std::min(max_height_, old_height - 1);
+    return false;
+  }
+
+  int min_height = std::numeric_limits<int>::max();
+  size_t min_edge_index = 0;
+  for (size_t i = 0; i < graph_.GetOutEdgeNumber(node->index); i++) {
+    const Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
+    Node<FlowType>* dst = graph_.GetDst(edge);
+    FlowType res = HaoOrlinResidual(edge);
+    if (layer_[dst->index] == kAwake && res > 0 && !IsClose(res, 0) && min_height > dst->height) {
+      min_height = dst->height;
+      min_edge_index = i;
+    }
+  }
+  if (min_height == std::numeric_limits<int>::max()) {
+    dormant_sets_.push_back(std::vector<Node<FlowType>*>());
+    HaoOrlinSleep(node, dormant_sets_.size() - 1);
+    return false;
+  }
+  node->current_edge_idx = min_edge_index;
+  node->height = min_height + 1;
+  return true;
+}
+
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinDischarge(Node<FlowType>* node) {
+  while (true) {
+    const Edge<FlowType>* current_edge = graph_.GetEdge(node->index, node->current_edge_idx);
+    FlowType res = HaoOrlinResidual(current_edge);
+    if (res > 0 && !IsClose(res, 0)) {
+      Node<FlowType>* dst = graph_.GetDst(current_edge);
+      if (layer_[dst->index] == kAwake && dst->height < node->height) {
+        HaoOrlinPush(current_edge, std::min(node->excess, res));
+        if (IsClose(node->excess, 0)) {
+          break;
+        }
+      }
+    }
+    if (node->current_edge_idx == graph_.GetOutEdgeNumber(node->index) - 1) {
+      if (!HaoOrlinRelabel(node)) {
+        break;
+      }
+    }
+    else {
+      node->current_edge_idx += 1;
+    }
+  }
+  if (layer_[node->index] == kAwake) {
+    HaoOrlinInsert(node);
+  }
+}
+
+// Heights of the awake nodes are set to the sink height plus their exact
+// distance to the sink in W, as in GlobalRelabeling (valid heights can only
+// grow this way). Awake nodes that cannot reach the sink become a dormant set.
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinGlobalRelabeling() {
+  TraceSpan span(&tracer_, "GlobalRelabeling");
+  const Edge<FlowType>* edges = graph_.GetEdges();
+  auto open = [&](const Edge<FlowType>* edge) {
+    FlowType res = HaoOrlinResidual(edge);
+    return res > 0 && !IsClose(res, 0);
+  };
+  bfs_.Run(graph_.GetOffsets(), edges, graph_.GetNodeNumber(),
+    std::vector<size_t>(1, global_sink_->index), num_threads_, &pool_,
+    [&](size_t e) {
+      return layer_[edges[e].dst] == kAwake && open(&edges[edges[e].reversed]);
+    },
+    [&](size_t e) {
+      return layer_[edges[e].src] == kAwake && open(&edges[e]);
+    });
+
+  // No awake node is below the sink.
+  std::vector<Node<FlowType>*> awake;
+  for (int h = global_sink_->height; h <= max_awake_height_; h++) {
+    awake.insert(awake.end(), active_nodes_[h].begin(), active_nodes_[h].end());
+    awake.insert(awake.end(), inactive_nodes_[h].begin(), inactive_nodes_[h].end());
+    active_nodes_[h].clear();
+    inactive_nodes_[h].clear();
+  }
+  max_height_ = -1;
+  max_awake_height_ = global_sink_->height;
+  bool stranded = false;
+  for (auto node_it = awake.begin(); node_it != awake.end(); node_it++) {
+    Node<FlowType>* node = *node_it;
+    int level = bfs_.Level(node->index);
+    if (level < 0) {
+      if (!stranded) {
+        dormant_sets_.push_back(std::vector<Node<FlowType>*>());
+        stranded = true;
+      }
+      HaoOrlinSleep(node, dormant_sets_.size() - 1);
+    }
+    else {
+      node->height = global_sink_->height + level;
+      node->current_edge_idx = 0;
+      HaoOrlinInsert(node);
+    }
+  }
+  span.SetArg((long long) awake.size());
+}
+
+// Put an awake node (out of the buckets) into the bucket of its height.
+// Heights of awake nodes can pass n, so the buckets grow as needed.
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinInsert(Node<FlowType>* node) {
+  int height = node->height;
+  if (height >= (int) active_nodes_.size()) {
+    active_nodes_.resize(2 * height);
+    inactive_nodes_.resize(2 * height);
+  }
+  if (node != global_sink_ && node->excess > 0 && !IsClose(node->excess, 0)) {
+    active_nodes_[height].push_back(node);
+    max_height_ = std::max(height, max_height_);
+  }
+  else {
+    inactive_nodes_[height].push_back(node);
+  }
+  max_awake_height_ = std::max(height, max_awake_height_);
+}
+
+// Move an awake node (out of the buckets) to S (layer 0) or a dormant set.
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinSleep(Node<FlowType>* node, size_t layer) {
+  layer_[node->index] = (int) layer;
+  dormant_sets_[layer].push_back(node);
+  awake_number_ -= 1;
+  awake_changes_.push_back(node->index);
+}
+
+// Saturate the edges from a new node of S to the nodes outside S.
+template <typename FlowType>
+void MaxflowGraph<FlowType>::HaoOrlinSaturate(Node<FlowType>* node) {
+  for (size_t i = 0; i < graph_.GetOutEdgeNumber(node->index); i++) {
+    const Edge<FlowType>* edge = graph_.GetEdge(node->index, i);
+    FlowType res = HaoOrlinResidual(edge);
+    if (layer_[edge->dst] != 0 && res > 0 && !IsClose(res, 0)) {
+      HaoOrlinPush(edge, res);
+    }
+  }
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+template <typename FlowType>
+PyObject* MaxflowGraph<FlowType>::ToPythonMatching() {
+  PyObject* ret = PyList_New(matching_.size());
+  for (size_t k = 0; k < matching_.size(); k++) {
+    PyList_SET_ITEM(ret, k, Py_BuildValue("(ii)", matching_[k].first, matching_[k].second));
+  }
+  return ret;
+}
+
+template <typename FlowType>
+PyObject* MaxflowGraph<FlowType>::ToPythonCutNodes() {
+  if (!done_mincut_) {
+    std::cerr << "Warning: ToPythonCutNodes must be called after MinCut." << std::endl;
+    return NULL;
+  }
+  PyObject* nodes = PySet_New(NULL);
+  for (size_t i = 0; i < graph_.GetNodeNumber(); i++) {
+    Node<FlowType>* node = graph_.GetNode(i);
+    if (!graph_.IsOutCopy(node)) {
+      continue;
+    }
+    Node<FlowType>* in_copy = graph_.GetInCopy(node);
+    if (!reacheable_from_sink_[in_copy->index] && reacheable_from_sink_[node->index]) {
+      PyObject* name = PyLong_FromLong((long) in_copy->name);
+      PySet_Add(nodes, name);
+      Py_DECREF(name);
+    }
+  }
+  return nodes;
+}
+
+template <typename FlowType>
+PyObject* MaxflowGraph<FlowType>::ToPythonGlobalMinCut() {
+  if (!done_global_mincut_) {
+    std::cerr << "Warning: ToPythonGlobalMinCut must be called after GlobalMinCut." << std::endl;
+    return NULL;
+  }
+  PyObject* cut = PySet_New(NULL);
+  PyObject* cut_c = PySet_New(NULL);
+  for (size_t i = 0; i < graph_.GetNodeNumber(); i++) {
+    PyObject* name = PyLong_FromLong((long) graph_.GetNode(i)->name);
+    PySet_Add(global_cut_source_side_[i] ? cut : cut_c, name);
+    Py_DECREF(name);
+  }
+  PyObject* partition = PyTuple_Pack(2, cut, cut_c);
+  PyObject* value = PyFloat_FromDouble((double) global_cut_value_);
+  PyObject* ret = PyTuple_Pack(2, value, partition);
+
+  Py_XDECREF(cut);
+  Py_XDECREF(cut_c);
+  Py_XDECREF(partition);
+  Py_XDECREF(value);
+  return ret;
+}
+
+template <typename FlowType>
+PyObject* MaxflowGraph<FlowType>::ToPythonTrace() {
+  std::string str = ToChromeTrace();
+  return PyUnicode_FromString(str.data());
+}
+#endif
 
 }
 
@@ -0,0 +1,301 @@
+#ifndef _MEMORY_H
+#define _MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+// Placement of the large arrays of a Graph (nodes, CSR offsets, edges,
+// flows). Push-relabel reads them in random order, so on graphs with
+// hundreds of millions of edges TLB misses and remote NUMA accesses dominate.
+//
+// Blocks of at least kLargeAllocation bytes are mapped with mmap and get
+// - huge pages: explicit (MAP_HUGETLB, from the pages reserved in
+//   /proc/sys/vm/nr_hugepages) or transparent (madvise(MADV_HUGEPAGE));
+//   explicit falls back to transparent, transparent to normal pages;
+// - NUMA placement: interleaved over the allowed nodes (mbind), or first
+//   touch, where each page is touched by the thread that PinnedParallelFor
+//   hands that part of the array to. That thread is pinned to a CPU, as are
+//   the solver threads (ThreadPool::SetPinned), so a page lands on the node
+//   of the CPU that runs the same chunk of the parallel phases. Both need at
+//   least two allowed NUMA nodes and fall back to no policy otherwise.
+// Smaller blocks use operator new. What took effect is reported by
+// AllocationState::Report.
+
+namespace cmaxflow {
+
+enum PagePolicy {
+  kDefaultPages = 0,
+  kTransparentHugePages = 1,
+  kExplicitHugePages = 2
+};
+
+enum NumaPolicy {
+  kNoNumaPolicy = 0,
+  kFirstTouch = 1,
+  kInterleave = 2
+};
+
+static const size_t kHugePageSize = (size_t) 2 << 20;
+static const size_t kLargeAllocation = kHugePageSize;
+
+// Policies in effect for all large blocks alive (the weakest one if they
+// differ), and their total size. Both policies are the defaults if there is
+// no large block.
+struct AllocationReport {
+  int pages;
+  int numa;
+  size_t large_bytes;
+};
+
+inline bool TransparentHugePagesEnabled() {
+  static const bool enabled = [] {
+    std::FILE* f = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == nullptr) {
+      return false;
+    }
+    char buf[128] = {0};
+    size_t len = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    buf[len] = 0;
+    return std::strstr(buf, "[never]") == nullptr;
+  }();
+  return enabled;
+}
+
+// NUMA nodes this process may allocate on; returns their number.
+inline int AllowedNumaNodes(unsigned long* mask, size_t mask_words) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+  const int kMpolFMemsAllowed = 4;
+  std::memset(mask, 0, mask_words * sizeof(unsigned long));
+  if (syscall(SYS_get_mempolicy, nullptr, mask, mask_words * 8 * sizeof(unsigned long),
+      nullptr, kMpolFMemsAllowed) != 0) {
+    return 0;
+  }
+  int count = 0;
+  for (size_t w = 0; w < mask_words; w++) {
+    count += __builtin_popcountl(mask[w]);
+  }
+  return count;
+#else
+  (void) mask;
+  (void) mask_words;
+  return 0;
+#endif
+}
+
+// True if the NUMA policies can change the placement.
+inline bool MultipleNumaNodes() {
+  unsigned long mask[16];
+  return AllowedNumaNodes(mask, 16) >= 2;
+}
+
+// Allocation policy of one Graph and its large blocks.
+class AllocationState {
+public:
+  AllocationState() : pages_(kDefaultPages), numa_(kNoNumaPolicy), num_threads_(0) {}
+  ~AllocationState() {}
+  AllocationState(const AllocationState&) = delete;
+  AllocationState& operator=(const AllocationState&) = delete;
+
+  // num_threads is the thread number of the first touch (0 = all hardware
+  // threads). Applies to blocks allocated afterwards.
+  void SetPolicy(int pages, int numa, unsigned int num_threads) {
+    pages_ = pages;
+    numa_ = numa;
+    num_threads_ = num_threads;
+  }
+
+  AllocationReport Report() const {
+    AllocationReport report = {kDefaultPages, kNoNumaPolicy, 0};
+    for (auto it = blocks_.begin(); it != blocks_.end(); it++) {
+      const Block& block = it->second;
+      if (report.large_bytes == 0) {
+        report.pages = block.pages;
+        report.numa = block.numa;
+      }
+      report.pages = std::min(report.pages, block.pages);
+      report.numa = std::min(report.numa, block.numa);
+      report.large_bytes += block.length;
+    }
+    return report;
+  }
+
+  void* Allocate(size_t bytes) {
+    if (bytes < kLargeAllocation || (pages_ == kDefaultPages && numa_ == kNoNumaPolicy)) {
+      return ::operator new(bytes);
+    }
+    Block block;
+    block.length = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    block.pages = kDefaultPages;
+    block.numa = kNoNumaPolicy;
+    void* addr = nullptr;
+#ifdef MAP_HUGETLB
+    if (pages_ == kExplicitHugePages) {
+      addr = mmap(nullptr, block.length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (addr == MAP_FAILED) {
+        addr = nullptr;
+      }
+      else {
+        block.pages = kExplicitHugePages;
+      }
+    }
+#endif
+    if (addr == nullptr) {
+      addr = MapAligned(block.length);
+      if (addr == nullptr) {
+        throw std::bad_alloc();
+      }
+#ifdef MADV_HUGEPAGE
+      if (pages_ != kDefaultPages && TransparentHugePagesEnabled()
+          && madvise(addr, block.length, MADV_HUGEPAGE) == 0) {
+        block.pages = kTransparentHugePages;
+      }
+#endif
+    }
+    if (numa_ == kInterleave && Interleave(addr, block.length)) {
+      block.numa = kInterleave;
+    }
+    else if (numa_ == kFirstTouch && MultipleNumaNodes()) {
+      Touch(addr, bytes);
+      block.numa = kFirstTouch;
+    }
+    blocks_[addr] = block;
+    return addr;
+  }
+
+  void Deallocate(void* p) {
+    auto it = blocks_.find(p);
+    if (it == blocks_.end()) {
+      ::operator delete(p);
+      return;
+    }
+    munmap(p, it->second.length);
+    blocks_.erase(it);
+  }
+
+private:
+  struct Block {
+    size_t length;
+    int pages;
+    int numa;
+  };
+
+  int pages_;
+  int numa_;
+  unsigned int num_threads_;
+  std::map<void*, Block> blocks_;
+
+  // Map length bytes aligned to kHugePageSize, so that transparent huge
+  // pages can back the whole block.
+  static void* MapAligned(size_t length) {
+    void* addr = mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      return nullptr;
+    }
+    uintptr_t begin = (uintptr_t) addr;
+    uintptr_t aligned = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    if (aligned > begin) {
+      munmap(addr, aligned - begin);
+    }
+    uintptr_t end = begin + length + kHugePageSize;
+    if (end > aligned + length) {
+      munmap((void*) (aligned + length), end - (aligned + length));
+    }
+    return (void*) aligned;
+  }
+
+  // Interleave the pages over the allowed NUMA nodes; false if there is only
+  // one node or the kernel refuses.
+  static bool Interleave(void* addr, size_t length) {
+#if defined(__linux__) && defined(SYS_mbind)
+    const int kMpolInterleave = 3;
+    unsigned long mask[16];
+    if (AllowedNumaNodes(mask, 16) < 2) {
+      return false;
+    }
+    return syscall(SYS_mbind, addr, length, kMpolInterleave, mask,
+      16 * 8 * sizeof(unsigned long), 0) == 0;
+#else
+    (void) addr;
+    (void) length;
+    return false;
+#endif
+  }
+
+  // Write each page of the first bytes of a block from the pinned thread
+  // that PinnedParallelFor gives that part of the array to.
+  void Touch(void* addr, size_t bytes) {
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t pages = (bytes + page_size - 1) / page_size;
+    volatile char* base = (volatile char*) addr;
+    PinnedParallelFor(pages, ResolveThreadNumber(num_threads_, pages),
+      [&](unsigned int, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+          base[k * page_size] = 0;
+        }
+      });
+  }
+};
+
+// std::vector allocator drawing from an AllocationState (operator new
+// without one).
+template <typename T>
+class PolicyAllocator {
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  PolicyAllocator() : state_(nullptr) {}
+  explicit PolicyAllocator(AllocationState* state) : state_(state) {}
+  template <typename U>
+  PolicyAllocator(const PolicyAllocator<U>& other) : state_(other.state()) {}
+
+  T* allocate(size_t n) {
+    size_t bytes = n * sizeof(T);
+    return (T*) (state_ == nullptr ? ::operator new(bytes) : state_->Allocate(bytes));
+  }
+
+  void deallocate(T* p, size_t) {
+    if (state_ == nullptr) {
+      ::operator delete(p);
+    }
+    else {
+      state_->Deallocate(p);
+    }
+  }
+
+  AllocationState* state() const { return state_; }
+
+private:
+  AllocationState* state_;
+};
+
+template <typename T, typename U>
+bool operator==(const PolicyAllocator<T>& a, const PolicyAllocator<U>& b) {
+  return a.state() == b.state();
+}
+
+template <typename T, typename U>
+bool operator!=(const PolicyAllocator<T>& a, const PolicyAllocator<U>& b) {
+  return a.state() != b.state();
+}
+
+}
+
+#endif
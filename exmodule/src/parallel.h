@@ -0,0 +1,307 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace cmaxflow {
+
+// Number of threads used when the caller passes num_threads = 0.
+inline unsigned int DefaultThreadNumber() {
+  unsigned int n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+// Resolve a requested thread number against the amount of work.
+inline unsigned int ResolveThreadNumber(unsigned int num_threads, size_t size) {
+  if (num_threads == 0) {
+    num_threads = DefaultThreadNumber();
+  }
+  if ((size_t) num_threads > size) {
+    num_threads = size > 0 ? (unsigned int) size : 1;
+  }
+  return num_threads;
+}
+
+// Begin of the k-th of num_chunks contiguous chunks of [0, size).
+inline size_t ChunkBegin(size_t size, unsigned int num_chunks, unsigned int k) {
+  return size / num_chunks * k + std::min((size_t) k, size % num_chunks);
+}
+
+// Split [0, size) into num_threads contiguous chunks and call
+// f(thread_id, begin, end) on each chunk from its own thread.
+// The chunking only depends on (size, num_threads), so two calls with the
+// same arguments hand the same range to the same thread_id.
+// num_threads must already be resolved (see ResolveThreadNumber).
+template <typename Function>
+void ParallelFor(size_t size, unsigned int num_threads, Function f) {
+  if (num_threads <= 1) {
+    f(0u, (size_t) 0, size);
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(num_threads - 1);
+  for (unsigned int k = 1; k < num_threads; k++) {
+    size_t begin = ChunkBegin(size, num_threads, k);
+    size_t end = ChunkBegin(size, num_threads, k + 1);
+    workers.push_back(std::thread(f, k, begin, end));
+  }
+  f(0u, (size_t) 0, ChunkBegin(size, num_threads, 1));
+  for (auto it = workers.begin(); it != workers.end(); it++) {
+    it->join();
+  }
+}
+
+// CPUs a thread may run on.
+struct CpuSet {
+#ifdef __linux__
+  cpu_set_t cpus;
+#endif
+  bool valid;
+};
+
+inline CpuSet ThreadCpus() {
+  CpuSet set;
+  set.valid = false;
+#ifdef __linux__
+  CPU_ZERO(&set.cpus);
+  set.valid = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &set.cpus) == 0
+    && CPU_COUNT(&set.cpus) > 0;
+#endif
+  return set;
+}
+
+// Pin the calling thread to the k-th CPU of set (modulo their number), or
+// give it all of set back if k < 0.
+inline bool PinThread(const CpuSet& set, int k) {
+#ifdef __linux__
+  if (!set.valid) {
+    return false;
+  }
+  if (k < 0) {
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set.cpus) == 0;
+  }
+  int skip = k % CPU_COUNT(&set.cpus);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set.cpus) && skip-- == 0) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &one) == 0;
+    }
+  }
+#endif
+  (void) set;
+  (void) k;
+  return false;
+}
+
+// ParallelFor where the thread of chunk k runs on the k-th CPU the caller
+// may use, so that chunk k of two calls with the same arguments runs on the
+// same CPU (first-touch placement). The caller runs chunk 0 pinned and gets
+// its CPUs back afterwards.
+template <typename Function>
+void PinnedParallelFor(size_t size, unsigned int num_threads, Function f) {
+  CpuSet set = ThreadCpus();
+  ParallelFor(size, num_threads, [&](unsigned int k, size_t begin, size_t end) {
+    PinThread(set, (int) k);
+    f(k, begin, end);
+  });
+  PinThread(set, -1);
+}
+
+// Worker threads kept between parallel loops. For(size, num_threads, f)
+// splits the work like ParallelFor, but hands the chunks to parked workers
+// instead of creating and joining threads on every call (e.g. every level of
+// a breadth-first search). Workers are started on first use. Calls must not
+// overlap.
+class ThreadPool {
+public:
+  ThreadPool() : generation_(0), size_(0), active_(0), pending_(0), stop_(false),
+    context_(nullptr), call_(nullptr), owner_(0), pinned_(false), pin_epoch_(0) {}
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  template <typename Function>
+  void For(size_t size, unsigned int num_threads, Function f);
+
+  // Run chunk k on the k-th CPU of the calling thread, as PinnedParallelFor
+  // does, or let the threads move again.
+  void SetPinned(bool pinned);
+
+private:
+  void Grow(unsigned int num_workers);
+  void Work(unsigned int k, unsigned long long seen);
+  // The workers are not copied into a child process after fork.
+  bool Forked() const { return !workers_.empty() && owner_ != getpid(); }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  // Current loop: workers run it when generation_ changes.
+  unsigned long long generation_;
+  size_t size_;
+  unsigned int active_;
+  unsigned int pending_;
+  bool stop_;
+  void* context_;
+  void (*call_)(void*, unsigned int, size_t, size_t);
+  pid_t owner_;
+  // CPUs of the caller when pinning was enabled; workers apply a change of
+  // pinned_ when they see a new pin_epoch_.
+  bool pinned_;
+  unsigned int pin_epoch_;
+  CpuSet cpus_;
+};
+
+inline ThreadPool::~ThreadPool() {
+  if (Forked()) {
+    // The threads do not exist here and cannot be joined.
+    (void) new std::vector<std::thread>(std::move(workers_));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto it = workers_.begin(); it != workers_.end(); it++) {
+    it->join();
+  }
+}
+
+inline void ThreadPool::Grow(unsigned int num_workers) {
+  owner_ = getpid();
+  while (workers_.size() < num_workers) {
+    unsigned int k = (unsigned int) workers_.size() + 1;
+    workers_.push_back(std::thread(&ThreadPool::Work, this, k, generation_));
+  }
+}
+
+inline void ThreadPool::SetPinned(bool pinned) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pinned && !pinned_) {
+    cpus_ = ThreadCpus();
+  }
+  if (pinned != pinned_) {
+    pinned_ = pinned;
+    pin_epoch_ += 1;
+  }
+}
+
+inline void ThreadPool::Work(unsigned int k, unsigned long long seen) {
+  unsigned int pin_epoch = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    if (k >= active_) {
+      continue;
+    }
+    size_t begin = ChunkBegin(size_, active_, k);
+    size_t end = ChunkBegin(size_, active_, k + 1);
+    void* context = context_;
+    void (*call)(void*, unsigned int, size_t, size_t) = call_;
+    if (pin_epoch != pin_epoch_) {
+      pin_epoch = pin_epoch_;
+      PinThread(cpus_, pinned_ ? (int) k : -1);
+    }
+    lock.unlock();
+    call(context, k, begin, end);
+    lock.lock();
+    pending_ -= 1;
+    if (pending_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+template <typename Function>
+void ThreadPool::For(size_t size, unsigned int num_threads, Function f) {
+  if (num_threads <= 1) {
+    f(0u, (size_t) 0, size);
+    return;
+  }
+  if (Forked()) {
+    if (pinned_) {
+      PinnedParallelFor(size, num_threads, f);
+    }
+    else {
+      ParallelFor(size, num_threads, f);
+    }
+    return;
+  }
+  Grow(num_threads - 1);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    context_ = &f;
+    call_ = [](void* context, unsigned int k, size_t begin, size_t end) {
+      (*static_cast<Function*>(context))(k, begin, end);
+    };
+    size_ = size;
+    active_ = num_threads;
+    pending_ = num_threads - 1;
+    generation_ += 1;
+  }
+  wake_.notify_all();
+  if (pinned_) {
+    PinThread(cpus_, 0);
+  }
+  f(0u, (size_t) 0, ChunkBegin(size, num_threads, 1));
+  if (pinned_) {
+    PinThread(cpus_, -1);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&] { return pending_ == 0; });
+}
+
+// Sort each chunk on its own thread, then merge neighbouring runs pairwise.
+template <typename T, typename Compare>
+void ParallelSort(std::vector<T>* v, unsigned int num_threads, Compare comp) {
+  size_t size = v->size();
+  num_threads = ResolveThreadNumber(num_threads, size);
+  ParallelFor(size, num_threads, [&](unsigned int, size_t begin, size_t end) {
+    std::sort(v->begin() + begin, v->begin() + end, comp);
+  });
+
+  std::vector<size_t> bounds(num_threads + 1);
+  for (unsigned int k = 0; k <= num_threads; k++) {
+    bounds[k] = ChunkBegin(size, num_threads, k);
+  }
+  while (bounds.size() > 2) {
+    size_t num_merges = (bounds.size() - 1) / 2;
+    ParallelFor(num_merges, ResolveThreadNumber(num_threads, num_merges),
+      [&](unsigned int, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+          std::inplace_merge(v->begin() + bounds[2 * k],
+            v->begin() + bounds[2 * k + 1], v->begin() + bounds[2 * k + 2], comp);
+        }
+      });
+    std::vector<size_t> merged;
+    for (size_t k = 0; k < bounds.size(); k += 2) {
+      merged.push_back(bounds[k]);
+    }
+    if (merged.back() != size) {
+      merged.push_back(size);
+    }
+    bounds.swap(merged);
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _REORDER_H
+#define _REORDER_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "graph.h"
+
+// Node orders used to improve memory locality before solving.
+// Each function returns new_index such that the node with index i should get
+// index new_index[i] (see Graph::Reorder).
+// Edges are followed in both directions: every edge has its reversed edge in
+// the adjacency list of its destination.
+
+namespace cmaxflow {
+
+enum ReorderMethod {
+  kNoReorder = 0,
+  kBfsReorder = 1,     // BFS order from a root node (the sink for maxflow)
+  kRcmReorder = 2,     // reverse Cuthill-McKee
+  kDegreeReorder = 3   // descending degree
+};
+
+template <typename FlowType>
+std::vector<size_t> BfsOrder(Graph<FlowType>* graph, size_t root) {
+  size_t n = graph->GetNodeNumber();
+  std::vector<size_t> new_index(n, n);
+  std::deque<size_t> Q;
+  size_t next = 0;
+  for (size_t k = 0; k <= n; k++) {
+    size_t start = k == 0 ? root : k - 1;
+    if (new_index[start] != n) {
+      continue;
+    }
+    new_index[start] = next++;
+    Q.push_back(start);
+    while (!Q.empty()) {
+      size_t u = Q.front();
+      Q.pop_front();
+      for (size_t i = 0; i < graph->GetOutEdgeNumber(u); i++) {
+        size_t v = graph->GetEdge(u, i)->dst;
+        if (new_index[v] == n) {
+          new_index[v] = next++;
+          Q.push_back(v);
+        }
+      }
+    }
+  }
+  return new_index;
+}
+
+// Cuthill-McKee visits each component from a node of minimum degree and
+// enqueues neighbours by increasing degree; the final order is reversed.
+template <typename FlowType>
+std::vector<size_t> RcmOrder(Graph<FlowType>* graph) {
+  size_t n = graph->GetNodeNumber();
+  std::vector<size_t> by_degree(n);
+  for (size_t i = 0; i < n; i++) {
+    by_degree[i] = i;
+  }
+  std::stable_sort(by_degree.begin(), by_degree.end(), [&](size_t a, size_t b) {
+    return graph->GetOutEdgeNumber(a) < graph->GetOutEdgeNumber(b);
+  });
+
+  std::vector<bool> visited(n, false);
+  std::vector<size_t> order;
+  std::vector<size_t> neighbours;
+  order.reserve(n);
+  for (size_t k = 0; k < n; k++) {
+    size_t start = by_degree[k];
+    if (visited[start]) {
+      continue;
+    }
+    visited[start] = true;
+    size_t head = order.size();
+    order.push_back(start);
+    while (head < order.size()) {
+      size_t u = order[head++];
+      neighbours.clear();
+      for (size_t i = 0; i < graph->GetOutEdgeNumber(u); i++) {
+        size_t v = graph->GetEdge(u, i)->dst;
+        if (!visited[v]) {
+          visited[v] = true;
+          neighbours.push_back(v);
+        }
+      }
+      std::stable_sort(neighbours.begin(), neighbours.end(), [&](size_t a, size_t b) {
+        return graph->GetOutEdgeNumber(a) < graph->GetOutEdgeNumber(b);
+      });
+      order.insert(order.end(), neighbours.begin(), neighbours.end());
+    }
+  }
+
+  std::vector<size_t> new_index(n);
+  for (size_t k = 0; k < n; k++) {
+    new_index[order[k]] = n - 1 - k;
+  }
+  return new_index;
+}
+
+template <typename FlowType>
+std::vector<size_t> DegreeOrder(Graph<FlowType>* graph) {
+  size_t n = graph->GetNodeNumber();
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return graph->GetOutEdgeNumber(a) > graph->GetOutEdgeNumber(b);
+  });
+  std::vector<size_t> new_index(n);
+  for (size_t k = 0; k < n; k++) {
+    new_index[order[k]] = k;
+  }
+  return new_index;
+}
+
+}
+
+#endif
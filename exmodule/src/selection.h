@@ -0,0 +1,139 @@
+#ifndef _SELECTION_H
+#define _SELECTION_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+
+#include "graph.h"
+
+namespace cmaxflow {
+
+// A set of nodes with the same height.
+// Node::index_in_bucket holds the position of a node in its bucket, so that
+// removal is O(1). The interface follows std::list where the solver used it.
+template <typename FlowType>
+class NodeBucket {
+public:
+  typedef typename std::vector<Node<FlowType>*>::iterator iterator;
+
+  iterator begin() { return nodes_.begin(); }
+  iterator end() { return nodes_.end(); }
+  bool empty() const { return nodes_.empty(); }
+  size_t size() const { return nodes_.size(); }
+  void clear() { nodes_.clear(); }
+  Node<FlowType>* back() { return nodes_.back(); }
+
+  void push_back(Node<FlowType>* node) {
+    node->index_in_bucket = nodes_.size();
+    nodes_.push_back(node);
+  }
+
+  void pop_back() {
+    nodes_.pop_back();
+  }
+
+  bool contains(Node<FlowType>* node) const {
+    return node->index_in_bucket < nodes_.size() && nodes_[node->index_in_bucket] == node;
+  }
+
+  // Remove node by moving the last node to its position.
+  void remove(Node<FlowType>* node) {
+    if (!contains(node)) {
+      return;
+    }
+    Node<FlowType>* last = nodes_.back();
+    nodes_[node->index_in_bucket] = last;
+    last->index_in_bucket = node->index_in_bucket;
+    nodes_.pop_back();
+  }
+
+private:
+  std::vector<Node<FlowType>*> nodes_;
+};
+
+// Active-node selection rules of MaxflowGraph::MaxPreFlow.
+// The solver is instantiated for each policy, so the main loop calls
+// Activate/Next without runtime dispatch.
+//
+// All policies keep active nodes in the per-height buckets, which the gap
+// heuristic relies on. Queue-based policies also record the order of
+// activation in a deque; entries of nodes lifted by a gap (height >= n) are
+// dropped when they reach the front.
+enum SelectionRule {
+  kHighestLabel = 0,
+  kFifo = 1,
+  kLifo = 2
+};
+
+// Discharge an active node with the largest height. No active node is
+// below min_height (Hao-Orlin keeps them above the sink), so the scan of
+// the empty buckets stops there.
+struct HighestLabelSelection {
+  template <typename FlowType>
+  static void Activate(std::deque<Node<FlowType>*>*, Node<FlowType>*) {}
+
+  template <typename FlowType>
+  static Node<FlowType>* Next(std::deque<Node<FlowType>*>*,
+    std::vector<NodeBucket<FlowType>>* active_nodes, int* max_height, int,
+    int min_height = 0) {
+    while (*max_height >= min_height && (*active_nodes)[*max_height].empty()) {
+      *max_height -= 1;
+    }
+    if (*max_height < min_height) {
+      return nullptr;
+    }
+    Node<FlowType>* node = (*active_nodes)[*max_height].back();
+    (*active_nodes)[*max_height].pop_back();
+    return node;
+  }
+};
+
+// Discharge active nodes in the order they became active.
+struct FifoSelection {
+  template <typename FlowType>
+  static void Activate(std::deque<Node<FlowType>*>* queue, Node<FlowType>* node) {
+    queue->push_back(node);
+  }
+
+  template <typename FlowType>
+  static Node<FlowType>* Next(std::deque<Node<FlowType>*>* queue,
+    std::vector<NodeBucket<FlowType>>* active_nodes, int*, int n) {
+    while (!queue->empty()) {
+      Node<FlowType>* node = queue->front();
+      queue->pop_front();
+      if (node->height < n && (*active_nodes)[node->height].contains(node)) {
+        (*active_nodes)[node->height].remove(node);
+        return node;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// Discharge the most recently activated node first. Excess travels along a
+// wave of pushes before older active nodes are revisited.
+struct LifoSelection {
+  template <typename FlowType>
+  static void Activate(std::deque<Node<FlowType>*>* queue, Node<FlowType>* node) {
+    queue->push_back(node);
+  }
+
+  template <typename FlowType>
+  static Node<FlowType>* Next(std::deque<Node<FlowType>*>* queue,
+    std::vector<NodeBucket<FlowType>>* active_nodes, int*, int n) {
+    while (!queue->empty()) {
+      Node<FlowType>* node = queue->back();
+      queue->pop_back();
+      if (node->height < n && (*active_nodes)[node->height].contains(node)) {
+        (*active_nodes)[node->height].remove(node);
+        return node;
+      }
+    }
+    return nullptr;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef _SHARED_H
+#define _SHARED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cmaxflow {
+
+// Layout of a graph exported to POSIX shared memory (see Graph::ExportShared).
+// The segment holds only the immutable part of a graph: node names, the CSR
+// offsets and the edge array (endpoints, capacities, reversed edges).
+// Each attached process keeps its own flows and node states.
+struct SharedGraphHeader {
+  char magic[8];
+  uint32_t flow_type_size;
+  uint32_t edge_size;
+  uint64_t node_number;
+  uint64_t edge_number;
+  uint64_t names_offset;
+  uint64_t offsets_offset;
+  uint64_t edges_offset;
+  uint64_t total_size;
+};
+
+static const char kSharedGraphMagic[8] = {'C', 'M', 'X', 'F', 'L', 'O', 'W', '1'};
+
+inline size_t AlignSharedOffset(size_t offset) {
+  return (offset + 63) / 64 * 64;
+}
+
+// A POSIX shared-memory object mapped into this process.
+class SharedSegment {
+public:
+  SharedSegment() : addr_(nullptr), size_(0) {}
+  ~SharedSegment() { Unmap(); }
+  SharedSegment(const SharedSegment&) = delete;
+  SharedSegment& operator=(const SharedSegment&) = delete;
+
+  // Create a new object of the given size and map it read-write.
+  // Fails if an object with the same name exists.
+  bool Create(const std::string& name, size_t size) {
+    Unmap();
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      std::cerr << "Warning: failed to create shared memory " << name
+      << " (" << std::strerror(errno) << ")." << std::endl;
+      return false;
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+      std::cerr << "Warning: failed to resize shared memory " << name << "." << std::endl;
+      close(fd);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    return Map(fd, size, PROT_READ | PROT_WRITE);
+  }
+
+  // Map an existing object read-only.
+  bool Open(const std::string& name) {
+    Unmap();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      std::cerr << "Warning: failed to open shared memory " << name
+      << " (" << std::strerror(errno) << ")." << std::endl;
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return false;
+    }
+    return Map(fd, (size_t) st.st_size, PROT_READ);
+  }
+
+  void Unmap() {
+    if (addr_ != nullptr) {
+      munmap(addr_, size_);
+      addr_ = nullptr;
+      size_ = 0;
+    }
+  }
+
+  static bool Unlink(const std::string& name) {
+    return shm_unlink(name.c_str()) == 0;
+  }
+
+  bool mapped() const { return addr_ != nullptr; }
+  char* data() const { return (char*) addr_; }
+  size_t size() const { return size_; }
+
+private:
+  void* addr_;
+  size_t size_;
+
+  bool Map(int fd, size_t size, int prot) {
+    void* addr = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      std::cerr << "Warning: failed to map shared memory." << std::endl;
+      return false;
+    }
+    addr_ = addr;
+    size_ = size;
+    return true;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+// Timeline of solver phases.
+// Spans are kept in a ring buffer when a Tracer is enabled and exported in
+// the Chrome trace-event format (chrome://tracing, Perfetto).
+// A disabled tracer costs one branch per span; spans only mark coarse phases.
+//
+// Define CMAXFLOW_USDT (with <sys/sdt.h> available) to also emit the USDT
+// probes cmaxflow:phase_begin(name) and cmaxflow:phase_end(name, duration_ns),
+// which perf/bpftrace can attach to without enabling the tracer.
+
+#ifdef CMAXFLOW_USDT
+#include <sys/sdt.h>
+#define CMAXFLOW_PROBE_BEGIN(name) DTRACE_PROBE1(cmaxflow, phase_begin, name)
+#define CMAXFLOW_PROBE_END(name, duration) DTRACE_PROBE2(cmaxflow, phase_end, name, duration)
+#else
+#define CMAXFLOW_PROBE_BEGIN(name)
+#define CMAXFLOW_PROBE_END(name, duration)
+#endif
+
+namespace cmaxflow {
+
+struct TraceEvent {
+  const char* name;  // must be a string literal
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  long long arg;
+};
+
+class Tracer {
+public:
+  Tracer() : enabled_(false), next_(0), recorded_(0) {
+    origin_ = std::chrono::steady_clock::now();
+  }
+
+  bool enabled() const { return enabled_; }
+
+  // Start recording into a ring buffer of the given number of spans.
+  void Enable(size_t capacity) {
+    events_.assign(capacity > 0 ? capacity : 1, TraceEvent());
+    next_ = 0;
+    recorded_ = 0;
+    origin_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+  }
+
+  void Disable() {
+    enabled_ = false;
+  }
+
+  uint64_t Now() const {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - origin_).count();
+  }
+
+  void Record(const char* name, uint64_t start_ns, uint64_t end_ns, long long arg) {
+    TraceEvent& event = events_[next_];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    event.arg = arg;
+    next_ = (next_ + 1) % events_.size();
+    recorded_ += 1;
+  }
+
+  // Chrome trace-event JSON of the spans in the buffer, oldest first.
+  std::string ToChromeTrace() const {
+    std::ostringstream ss;
+    size_t size = std::min((size_t) recorded_, events_.size());
+    size_t first = recorded_ > events_.size() ? next_ : 0;
+    ss << "{\"traceEvents\": [";
+    for (size_t k = 0; k < size; k++) {
+      const TraceEvent& event = events_[(first + k) % events_.size()];
+      ss << (k == 0 ? "\n" : ",\n");
+      ss << "{\"name\": \"" << event.name << "\", \"cat\": \"cmaxflow\", \"ph\": \"X\", "
+      << "\"ts\": " << event.start_ns / 1000 << "." << Pad3(event.start_ns % 1000) << ", "
+      << "\"dur\": " << event.duration_ns / 1000 << "." << Pad3(event.duration_ns % 1000) << ", "
+      << "\"pid\": 1, \"tid\": 1, \"args\": {\"value\": " << event.arg << "}}";
+    }
+    ss << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped_spans\": "
+    << (recorded_ > events_.size() ? recorded_ - events_.size() : 0) << "}}";
+    return ss.str();
+  }
+
+private:
+  bool enabled_;
+  std::chrono::steady_clock::time_point origin_;
+  std::vector<TraceEvent> events_;
+  size_t next_;
+  unsigned long long recorded_;
+
+  static std::string Pad3(uint64_t x) {
+    std::string s = std::to_string(x);
+    return std::string(3 - s.size(), '0') + s;
+  }
+};
+
+// Records the lifetime of a scope as one span.
+class TraceSpan {
+public:
+  TraceSpan(Tracer* tracer, const char* name, long long arg = 0)
+    : tracer_(tracer->enabled() ? tracer : nullptr), name_(name), arg_(arg), start_ns_(0) {
+    CMAXFLOW_PROBE_BEGIN(name_);
+    if (tracer_ != nullptr) {
+      start_ns_ = tracer_->Now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (tracer_ != nullptr) {
+      uint64_t end_ns = tracer_->Now();
+      tracer_->Record(name_, start_ns_, end_ns, arg_);
+      CMAXFLOW_PROBE_END(name_, end_ns - start_ns_);
+    }
+    else {
+      CMAXFLOW_PROBE_END(name_, 0);
+    }
+  }
+
+  void SetArg(long long arg) { arg_ = arg; }
+
+private:
+  Tracer* tracer_;
+  const char* name_;
+  long long arg_;
+  uint64_t start_ns_;
+};
+
+}
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef _UNITFLOW_H
+#define _UNITFLOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <limits>
+#include <utility>
+#include <iostream>
+
+#include "utils.h"
+
+#ifdef CMAXFLOW_WITH_PYTHON
+#include <Python.h>
+#endif
+
+//#define MAXFLOW_VERBOSE
+
+namespace cmaxflow {
+
+const uint32_t kUnreachedLevel = std::numeric_limits<uint32_t>::max();
+
+// Maximum flow on graphs where every capacity is 0 or 1 (edge connectivity,
+// edge-disjoint paths).
+// An edge is stored as a pair of arcs in CSR layout: the head node and the
+// paired arc, as 32-bit indices. The residual capacity of an arc is one bit,
+// so BFS and the current-arc scans skip saturated arcs a word at a time.
+// The solver is Dinic's algorithm, which runs in O(m sqrt(m)) on unit
+// capacities.
+class UnitMaxflowGraph {
+public:
+  UnitMaxflowGraph() : source_index_(0), sink_index_(0), done_maxflow_(false),
+    flow_value_(0), done_mincut_(false) {}
+
+  // capacities[i] (0 or 1) is the capacity of edge_list[i]. Parallel edges
+  // are kept as separate edges.
+  bool FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+    const std::vector<char>& capacities);
+#ifdef CMAXFLOW_WITH_PYTHON
+  // Same format as Graph::FromPyObject; every capacity must be 0 or 1.
+  bool FromPyObject(PyObject* p);
+#endif
+  bool SetSourceSink(int s, int t);
+
+  size_t GetNodeNumber() { return names_.size(); }
+  size_t GetEdgeNumber() { return head_.size() / 2; }
+
+  // The flow value is a count, returned as a double like MaxflowGraph.
+  double MaxFlow();
+  void MinCut();
+  // Side of the node with the given index in the cut of MinCut.
+  bool IsOnSourceSide(size_t index) { return !reacheable_from_sink_[index]; }
+  int GetNodeName(size_t index) { return names_[index]; }
+#ifdef CMAXFLOW_WITH_PYTHON
+  PyObject* ToPythonMinCut();
+#endif
+
+private:
+  std::map<int, size_t> name_map_;
+  std::vector<int> names_;
+  // Arcs of node u are [offsets_[u], offsets_[u + 1]).
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> head_;
+  std::vector<uint32_t> reversed_;
+  // Bit a is set if arc a has residual capacity (1).
+  std::vector<uint64_t> capacity_bits_;
+  std::vector<uint64_t> residual_bits_;
+
+  size_t source_index_;
+  size_t sink_index_;
+  bool done_maxflow_;
+  long long flow_value_;
+  bool done_mincut_;
+  std::vector<bool> reacheable_from_sink_;
+
+  // Dinic's state
+  std::vector<uint32_t> level_;
+  std::vector<uint32_t> current_arc_;
+  std::vector<uint32_t> queue_;
+  std::vector<uint32_t> path_;
+
+  bool HasResidual(uint32_t arc) const {
+    return (residual_bits_[arc >> 6] >> (arc & 63)) & 1;
+  }
+  void FlipResidual(uint32_t arc) {
+    residual_bits_[arc >> 6] ^= (uint64_t) 1 << (arc & 63);
+  }
+  uint32_t NextResidualArc(uint32_t arc, uint32_t end) const;
+  uint32_t NextAdmissibleArc(uint32_t node);
+  bool BuildLevels();
+  bool Augment();
+};
+
+
+// Implementation
+
+inline bool UnitMaxflowGraph::FromEdgeList(const std::vector<std::pair<int, int>>& edge_list,
+  const std::vector<char>& capacities) {
+  name_map_.clear();
+  names_.clear();
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  if (capacities.size() != edge_list.size()) {
+    std::cerr << "Warning: sizes of edge_list and capacities mismatch." << std::endl;
+    return false;
+  }
+  if (2 * edge_list.size() >= kUnreachedLevel) {
+    std::cerr << "Warning: too many edges for UnitMaxflowGraph." << std::endl;
+    return false;
+  }
+  // Node indices in the order of first appearance, as in Graph.
+  std::vector<uint32_t> endpoints(2 * edge_list.size());
+  for (size_t i = 0; i < edge_list.size(); i++) {
+    int names[2] = {edge_list[i].first, edge_list[i].second};
+    for (int k = 0; k < 2; k++) {
+      auto it = name_map_.emplace(names[k], names_.size()).first;
+      if (it->second == names_.size()) {
+        names_.push_back(names[k]);
+      }
+      endpoints[2 * i + k] = (uint32_t) it->second;
+    }
+  }
+  size_t n = names_.size();
+  size_t m = edge_list.size();
+
+  offsets_.assign(n + 1, 0);
+  for (size_t i = 0; i < 2 * m; i++) {
+    offsets_[endpoints[i] + 1] += 1;
+  }
+  for (size_t v = 0; v < n; v++) {
+    offsets_[v + 1] += offsets_[v];
+  }
+  std::vector<uint32_t> next(offsets_.begin(), offsets_.end() - 1);
+  head_.resize(2 * m);
+  reversed_.resize(2 * m);
+  capacity_bits_.assign((2 * m + 63) / 64, 0);
+  for (size_t i = 0; i < m; i++) {
+    uint32_t src = endpoints[2 * i];
+    uint32_t dst = endpoints[2 * i + 1];
+    uint32_t arc = next[src]++;
+    uint32_t arc_rev = next[dst]++;
+    head_[arc] = dst;
+    head_[arc_rev] = src;
+    reversed_[arc] = arc_rev;
+    reversed_[arc_rev] = arc;
+    if (capacities[i] != 0) {
+      capacity_bits_[arc >> 6] |= (uint64_t) 1 << (arc & 63);
+    }
+  }
+  residual_bits_ = capacity_bits_;
+  return true;
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+inline bool UnitMaxflowGraph::FromPyObject(PyObject* p) {
+  std::vector<std::pair<int, int>> edge_list;
+  std::vector<double> capacities;
+  std::vector<double> reverse_capacities;
+  if (!py_list_to_edge_list(p, &edge_list, &capacities, &reverse_capacities)) {
+    return false;
+  }
+  std::vector<char> unit_capacities(capacities.size());
+  for (size_t i = 0; i < capacities.size(); i++) {
+    // A pair of arcs holds one unit in total, so add (u, v) and (v, u)
+    // as separate edges instead.
+    if (!isclose<double>(reverse_capacities[i], 0.0, 1e-9)) {
+      PyErr_SetString(PyExc_ValueError,
+        "UnitMaxflowGraph: reverse_capacity is not supported, add both directions");
+      return false;
+    }
+    if (isclose<double>(capacities[i], 1.0, 1e-9)) {
+      unit_capacities[i] = 1;
+    }
+    else if (isclose<double>(capacities[i], 0.0, 1e-9)) {
+      unit_capacities[i] = 0;
+    }
+    else {
+      PyErr_SetString(PyExc_ValueError, "UnitMaxflowGraph: capacities must be 0 or 1");
+      return false;
+    }
+  }
+  return FromEdgeList(edge_list, unit_capacities);
+}
+#endif
+
+inline bool UnitMaxflowGraph::SetSourceSink(int s, int t) {
+  if (name_map_.count(s) == 0 || name_map_.count(t) == 0) {
+    std::cerr << "Warning: source or sink node are not found in graph." << std::endl;
+    return false;
+  }
+  source_index_ = name_map_[s];
+  sink_index_ = name_map_[t];
+  done_maxflow_ = false;
+  done_mincut_ = false;
+  return true;
+}
+
+// First arc in [arc, end) with residual capacity, or end.
+inline uint32_t UnitMaxflowGraph::NextResidualArc(uint32_t arc, uint32_t end) const {
+  while (arc < end) {
+    size_t w = arc >> 6;
+    uint64_t word = residual_bits_[w] & (~(uint64_t) 0 << (arc & 63));
+    if (word != 0) {
+      uint32_t found = (uint32_t) (w << 6) + (uint32_t) __builtin_ctzll(word);
+      return found < end ? found : end;
+    }
+    arc = (uint32_t) ((w + 1) << 6);
+  }
+  return end;
+}
+
+// Advance the current arc of node to the next arc into the next level.
+inline uint32_t UnitMaxflowGraph::NextAdmissibleArc(uint32_t node) {
+  uint32_t end = offsets_[node + 1];
+  uint32_t arc = current_arc_[node];
+  while ((arc = NextResidualArc(arc, end)) != end) {
+    if (level_[head_[arc]] == level_[node] + 1) {
+      break;
+    }
+    arc += 1;
+  }
+  current_arc_[node] = arc;
+  return arc;
+}
+
+// BFS from the source in the residual graph. Levels beyond the sink level
+// are not needed. Return true if the sink is reachable.
+inline bool UnitMaxflowGraph::BuildLevels() {
+  level_.assign(names_.size(), kUnreachedLevel);
+  queue_.clear();
+  level_[source_index_] = 0;
+  queue_.push_back((uint32_t) source_index_);
+  for (size_t head = 0; head < queue_.size(); head++) {
+    uint32_t u = queue_[head];
+    if (level_[sink_index_] != kUnreachedLevel && level_[u] >= level_[sink_index_]) {
+      break;
+    }
+    uint32_t end = offsets_[u + 1];
+    for (uint32_t arc = NextResidualArc(offsets_[u], end); arc != end;
+        arc = NextResidualArc(arc + 1, end)) {
+      uint32_t v = head_[arc];
+      if (level_[v] == kUnreachedLevel) {
+        level_[v] = level_[u] + 1;
+        queue_.push_back(v);
+      }
+    }
+  }
+  return level_[sink_index_] != kUnreachedLevel;
+}
+
+// Find one source-sink path in the level graph (iterative DFS with current
+// arcs) and send a unit of flow along it.
+inline bool UnitMaxflowGraph::Augment() {
+  path_.clear();
+  uint32_t u = (uint32_t) source_index_;
+  while (u != sink_index_) {
+    uint32_t arc = NextAdmissibleArc(u);
+    if (arc != offsets_[u + 1]) {
+      path_.push_back(arc);
+      u = head_[arc];
+      continue;
+    }
+    // Dead end: remove u from the level graph and retreat.
+    level_[u] = kUnreachedLevel;
+    if (path_.empty()) {
+      return false;
+    }
+    u = head_[reversed_[path_.back()]];
+    path_.pop_back();
+    current_arc_[u] += 1;
+  }
+  for (size_t k = 0; k < path_.size(); k++) {
+    FlipResidual(path_[k]);
+    FlipResidual(reversed_[path_[k]]);
+  }
+  return true;
+}
+
+inline double UnitMaxflowGraph::MaxFlow() {
+  residual_bits_ = capacity_bits_;
+  flow_value_ = 0;
+  done_mincut_ = false;
+  if (source_index_ != sink_index_) {
+    current_arc_.resize(names_.size());
+    while (BuildLevels()) {
+      for (size_t u = 0; u < names_.size(); u++) {
+        current_arc_[u] = offsets_[u];
+      }
+      while (Augment()) {
+        flow_value_ += 1;
+      }
+      #ifdef MAXFLOW_VERBOSE
+      std::cout << "Dinic phase done (flow = " << flow_value_ << ")" << std::endl;
+      #endif
+    }
+  }
+  done_maxflow_ = true;
+  return (double) flow_value_;
+}
+
+// The sink side of the cut is the set of nodes that can reach the sink in
+// the residual graph, as in MaxflowGraph::MinCut.
+inline void UnitMaxflowGraph::MinCut() {
+  if (!done_maxflow_) {
+    std::cerr << "Warning: MinCut must be called after MaxFlow." << std::endl;
+    return;
+  }
+  size_t n = names_.size();
+  reacheable_from_sink_.assign(n, false);
+  queue_.clear();
+  reacheable_from_sink_[sink_index_] = true;
+  queue_.push_back((uint32_t) sink_index_);
+  for (size_t head = 0; head < queue_.size(); head++) {
+    uint32_t u = queue_[head];
+    for (uint32_t arc = offsets_[u]; arc < offsets_[u + 1]; arc++) {
+      uint32_t v = head_[arc];
+      if (!reacheable_from_sink_[v] && HasResidual(reversed_[arc])) {
+        reacheable_from_sink_[v] = true;
+        queue_.push_back(v);
+      }
+    }
+  }
+  done_mincut_ = true;
+}
+
+#ifdef CMAXFLOW_WITH_PYTHON
+inline PyObject* UnitMaxflowGraph::ToPythonMinCut() {
+  if (!done_mincut_) {
+    std::cerr << "Warning: ToPythonMinCut must be called after MinCut." << std::endl;
+    return NULL;
+  }
+  PyObject* cut = PySet_New(NULL);
+  PyObject* cut_c = PySet_New(NULL);
+  for (size_t i = 0; i < names_.size(); i++) {
+    PyObject* name = PyLong_FromLong((long) names_[i]);
+    PySet_Add(reacheable_from_sink_[i] ? cut_c : cut, name);
+    Py_DECREF(name);
+  }
+  PyObject* ret = Py_BuildValue("(d(NN))", (double) flow_value_, cut, cut_c);
+  return ret;
+}
+#endif
+
+}
+
+#endif
@@ -9,14 +9,19 @@
 
 #include <cmath>
 #include <utility>
-#include <Python.h>
+#include <vector>
 
 template <typename T>
 bool isclose(T a, T b, T abs_tol) {
   return fabs(a - b) < abs_tol;
 }
 
-int py_int_to_int(PyObject* p) {
+// Conversions from Python objects, only for the Python extension
+// (define CMAXFLOW_WITH_PYTHON).
+#ifdef CMAXFLOW_WITH_PYTHON
+#include <Python.h>
+
+inline int py_int_to_int(PyObject* p) {
   auto set_value_error = [&] {
     PyErr_SetObject(PyExc_ValueError,
       PyUnicode_FromFormat(
@@ -90,8 +95,11 @@ std::vector<PyObject*> py_list_to_py_object_vector(PyObject* py_list) {
 // and a capacity vector (vector<double>). Both return values are set in-place.
 // The input Python object must be a list of tuples, and each tuple represent an
 // edge (u, v, {'capacity': capacity}).
-bool py_list_to_edge_list(PyObject* py_list,
-  std::vector<std::pair<int, int>>* edge_list, std::vector<double>* capacities) {
+// The dict may also have 'reverse_capacity', the capacity from v to u
+// (0 if missing), which is set to reverse_capacities if it is not nullptr.
+inline bool py_list_to_edge_list(PyObject* py_list,
+  std::vector<std::pair<int, int>>* edge_list, std::vector<double>* capacities,
+  std::vector<double>* reverse_capacities = nullptr) {
 
   auto set_value_error = [&](PyObject* p, char* expected){
     PyErr_SetObject(PyExc_ValueError,
@@ -111,6 +119,10 @@ bool py_list_to_edge_list(PyObject* py_list,
   edge_list->reserve((size_t) size);
   capacities->clear();
   capacities->reserve((size_t) size);
+  if (reverse_capacities != nullptr) {
+    reverse_capacities->clear();
+    reverse_capacities->reserve((size_t) size);
+  }
 
   for (Py_ssize_t i = 0; i < size; i++) {
     PyObject* py_edge = PyList_GetItem(py_list, i);
@@ -131,6 +143,11 @@ bool py_list_to_edge_list(PyObject* py_list,
       set_value_error(py_edge, (char *) "tuple(u, v, {'capacity': c})");
       return false;
     }
+    PyObject* py_reverse_capacity = PyDict_GetItemString(py_dict, "reverse_capacity");
+    if (py_reverse_capacity != NULL && !PyFloat_Check(py_reverse_capacity)) {
+      set_value_error(py_edge, (char *) "tuple(u, v, {'capacity': c, 'reverse_capacity': r})");
+      return false;
+    }
     int src = (int) PyLong_AsLong(py_src);
     int dst = (int) PyLong_AsLong(py_dst);
     double cap = (double) PyFloat_AsDouble(py_capacity);
@@ -140,9 +157,14 @@ bool py_list_to_edge_list(PyObject* py_list,
     #endif
     edge_list->push_back(std::make_pair(src, dst));
     capacities->push_back(cap);
+    if (reverse_capacities != nullptr) {
+      reverse_capacities->push_back(
+        py_reverse_capacity == NULL ? 0.0 : (double) PyFloat_AsDouble(py_reverse_capacity));
+    }
   }
   return true;
 }
+#endif
 
 
 #endif
@@ -4,16 +4,30 @@ from distutils.extension import Extension
 from Cython.Distutils import build_ext
 from Cython.Build import cythonize
 import numpy
+import os
+import sys
 
 numpy_include = numpy.get_include()
 
+# The engine headers include the Python conversions only with this macro
+define_macros = [('CMAXFLOW_WITH_PYTHON', None)]
+# Emit USDT probes for solver phases when systemtap headers are installed
+if os.path.exists('/usr/include/sys/sdt.h'):
+    define_macros.append(('CMAXFLOW_USDT', None))
+
+# shm_open lives in librt on older glibc
+libraries = ['rt'] if sys.platform.startswith('linux') else []
+
 extensions = [
     Extension(
         'exmodule.graph',
         sources = ['exmodule/graph.pyx'],
         include_dirs = [numpy_include],
         language = 'c++',
-        extra_compile_args = ['-std=c++11']
+        define_macros = define_macros,
+        libraries = libraries,
+        extra_compile_args = ['-std=c++11', '-pthread'],
+        extra_link_args = ['-pthread']
     )
 ]
 
@@ -0,0 +1,74 @@
+import glob
+
+import pytest
+
+from conftest import make_random_digraph, reference_cuts
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+PAGES = ['default', 'transparent', 'explicit']
+NUMA = ['none', 'first_touch', 'interleave']
+NUMA_NODES = len(glob.glob('/sys/devices/system/node/node[0-9]*'))
+
+
+@pytest.fixture(scope='module')
+def large_graph():
+    # Large enough for arrays over 2 MiB, which the policies apply to.
+    G = make_random_digraph(10000, 40000, seed=1)
+    return G, digraph_to_edge_list(G), reference_cuts(G, 0, 1)
+
+
+@pytest.mark.parametrize('numa', NUMA)
+@pytest.mark.parametrize('pages', PAGES)
+def test_policies_give_the_same_cuts(large_graph, pages, numa):
+    G, edge_list, (value, smallest, largest) = large_graph
+    g = CythonMaxflowGraph()
+    g.set_allocation_policy(pages, numa, 2)
+    g.from_py_object(edge_list, 0, 1)
+    g.reorder_nodes('bfs')
+    assert g.max_preflow(num_threads=2) == pytest.approx(value)
+    assert g.min_cut()[1][0] == largest
+    assert g.min_cut(minimal=True)[1][0] == smallest
+
+    report = g.allocation_report()
+    assert set(report) == {'pages', 'numa', 'large_bytes'}
+    if pages == 'default' and numa == 'none':
+        assert report == {'pages': 'default', 'numa': 'none', 'large_bytes': 0}
+        return
+    assert report['large_bytes'] >= 2 << 20
+    # Reserved huge pages may be missing, then transparent ones are used.
+    if pages == 'explicit':
+        assert report['pages'] in ('explicit', 'transparent')
+    else:
+        assert report['pages'] == pages
+    if NUMA_NODES < 2:
+        assert report['numa'] == 'none'
+    elif numa != 'none':
+        assert report['numa'] == numa
+
+
+def test_small_arrays_use_the_default_allocator(random_digraph, check_min_cut):
+    G = random_digraph(100, 400, seed=2)
+    g = CythonMaxflowGraph()
+    g.set_allocation_policy('transparent', 'interleave')
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+    assert g.allocation_report() == {'pages': 'default', 'numa': 'none', 'large_bytes': 0}
+
+
+def test_policy_applies_to_rebuilt_graphs(large_graph, random_digraph, check_min_cut):
+    G, edge_list, (value, _, _) = large_graph
+    g = CythonMaxflowGraph()
+    g.set_allocation_policy('transparent', 'first_touch', 0)
+    H = random_digraph(200, 1000, seed=3)
+    g.from_py_object(digraph_to_edge_list(H), 0, 1)
+    check_min_cut(H, 0, 1, g.min_cut(), minimal=False)
+    g.from_py_object(edge_list, 0, 1)
+    assert g.max_preflow(num_threads=0) == pytest.approx(value)
+    assert g.allocation_report()['pages'] == 'transparent'
+
+
+@pytest.mark.parametrize('pages,numa', [('huge', 'none'), ('default', 'local')])
+def test_unknown_policy(pages, numa):
+    g = CythonMaxflowGraph()
+    with pytest.raises(ValueError):
+        g.set_allocation_policy(pages, numa)
@@ -0,0 +1,137 @@
+import random
+
+import networkx as nx
+import numpy as np
+import pytest
+
+from conftest import reference_cuts
+from exmodule import CythonMaxflowGraph, solve_batch
+
+
+def random_batch(graph_number, seed, reverse=False, integer=True):
+    """Packed batch of small graphs, with parallel edges and self-loops."""
+    rng = random.Random(seed)
+    batch = {key: [] for key in ('src', 'dst', 'capacity', 'reverse_capacity',
+                                 'sources', 'sinks')}
+    node_offsets, edge_offsets = [0], [0]
+    for _ in range(graph_number):
+        n = rng.randint(2, 40)
+        m = rng.randint(0, 5 * n)
+        for _ in range(m):
+            batch['src'].append(rng.randrange(n))
+            batch['dst'].append(rng.randrange(n))
+            for key in ('capacity', 'reverse_capacity'):
+                c = rng.randint(0, 10) if integer else rng.uniform(0, 10)
+                batch[key].append(float(c) if reverse or key == 'capacity' else 0.0)
+        s, t = rng.sample(range(n), 2)
+        batch['sources'].append(s)
+        batch['sinks'].append(t)
+        node_offsets.append(node_offsets[-1] + n)
+        edge_offsets.append(edge_offsets[-1] + m)
+    batch['node_offsets'] = node_offsets
+    batch['edge_offsets'] = edge_offsets
+    if not reverse:
+        del batch['reverse_capacity']
+    return batch
+
+
+def graph_of(batch, g):
+    """Graph g of the batch as a DiGraph, parallel capacities added up."""
+    G = nx.DiGraph()
+    G.add_nodes_from(range(batch['node_offsets'][g + 1] - batch['node_offsets'][g]))
+    rev = batch.get('reverse_capacity')
+    for k in range(batch['edge_offsets'][g], batch['edge_offsets'][g + 1]):
+        u, v = batch['src'][k], batch['dst'][k]
+        for a, b, c in [(u, v, batch['capacity'][k]), (v, u, rev[k] if rev else 0.0)]:
+            if a != b and c > 0:
+                if G.has_edge(a, b):
+                    G[a][b]['capacity'] += c
+                else:
+                    G.add_edge(a, b, capacity=c)
+    return G
+
+
+def source_side_of(batch, source_side, g):
+    begin, end = batch['node_offsets'][g], batch['node_offsets'][g + 1]
+    return {v for v in range(end - begin) if source_side[begin + v]}
+
+
+@pytest.mark.parametrize('reverse,integer', [(False, True), (True, True), (False, False)])
+def test_batch_matches_networkx(reverse, integer):
+    batch = random_batch(150, seed=1, reverse=reverse, integer=integer)
+    flows, source_side = solve_batch(**batch)
+    assert flows.shape == (150,) and source_side.dtype == np.bool_
+    assert source_side.shape == (batch['node_offsets'][-1],)
+    for g in range(150):
+        G = graph_of(batch, g)
+        s, t = batch['sources'][g], batch['sinks'][g]
+        value, _, largest = reference_cuts(G, s, t)
+        assert flows[g] == pytest.approx(value)
+        # The cut of MinCut: the nodes that cannot reach the sink.
+        assert source_side_of(batch, source_side, g) == largest
+
+
+def test_batch_matches_single_solves():
+    batch = random_batch(60, seed=2, reverse=True)
+    flows, source_side = solve_batch(**batch)
+    rev = batch['reverse_capacity']
+    for g in range(60):
+        begin, end = batch['edge_offsets'][g], batch['edge_offsets'][g + 1]
+        edge_list = [(batch['src'][k], batch['dst'][k],
+                      {'capacity': batch['capacity'][k], 'reverse_capacity': rev[k]})
+                     for k in range(begin, end)]
+        s, t = batch['sources'][g], batch['sinks'][g]
+        nodes = {u for e in edge_list for u in e[:2]}
+        if s not in nodes or t not in nodes:
+            assert flows[g] == 0
+            continue
+        solver = CythonMaxflowGraph()
+        solver.from_py_object(edge_list, s, t)
+        value, (S, _) = solver.min_cut()
+        assert flows[g] == pytest.approx(value)
+        # Nodes without edges cannot reach the sink either.
+        n = batch['node_offsets'][g + 1] - batch['node_offsets'][g]
+        assert source_side_of(batch, source_side, g) == S | (set(range(n)) - nodes)
+
+
+@pytest.mark.parametrize('num_threads', [1, 2, 3, 0])
+def test_batch_independent_of_threads(num_threads):
+    batch = random_batch(100, seed=3)
+    flows, source_side = solve_batch(num_threads=1, **batch)
+    other_flows, other_source_side = solve_batch(num_threads=num_threads, **batch)
+    assert np.array_equal(flows, other_flows)
+    assert np.array_equal(source_side, other_source_side)
+
+
+def test_empty_batch():
+    flows, source_side = solve_batch([0], [0], [], [], [], [], [])
+    assert flows.shape == (0,) and source_side.shape == (0,)
+
+
+@pytest.mark.parametrize('change', ['node_offsets', 'edge_offsets', 'sinks', 'short_src',
+                                    'short_reverse', 'single_node', 'same_source_sink',
+                                    'sink_out_of_graph', 'edge_out_of_graph'])
+def test_malformed_batch(change):
+    batch = random_batch(5, seed=4, reverse=True)
+    if change == 'node_offsets':
+        batch['node_offsets'] = batch['node_offsets'][:-1]
+    elif change == 'edge_offsets':
+        batch['edge_offsets'] = batch['edge_offsets'] + [batch['edge_offsets'][-1]]
+    elif change == 'sinks':
+        batch['sinks'] = batch['sinks'][:-1]
+    elif change == 'short_src':
+        batch['src'] = batch['src'][:-1]
+    elif change == 'short_reverse':
+        batch['reverse_capacity'] = batch['reverse_capacity'][:-1]
+    elif change == 'single_node':
+        batch['node_offsets'][1] = batch['node_offsets'][0] + 1
+    elif change == 'same_source_sink':
+        batch['sinks'][2] = batch['sources'][2]
+    elif change == 'sink_out_of_graph':
+        batch['sinks'][2] = batch['node_offsets'][3] - batch['node_offsets'][2]
+    else:
+        g = next(g for g in range(5) if batch['edge_offsets'][g + 1] > batch['edge_offsets'][g])
+        k = batch['edge_offsets'][g + 1] - 1
+        batch['dst'][k] = batch['node_offsets'][g + 1] - batch['node_offsets'][g]
+    with pytest.raises(ValueError):
+        solve_batch(**batch)
@@ -0,0 +1,208 @@
+"""
+The C API (exmodule/src/cmaxflow.h), compiled into a shared library and
+called through ctypes.
+"""
+import ctypes
+import itertools
+import os
+import shutil
+import subprocess
+
+import networkx as nx
+import pytest
+
+from conftest import cut_capacity
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'exmodule', 'src')
+HIGHEST_LABEL, FIFO, LIFO = 0, 1, 2
+OPTIMAL, THRESHOLD_REACHED, WORK_LIMIT = 0, 1, 4
+
+c_int_p = ctypes.POINTER(ctypes.c_int)
+c_double_p = ctypes.POINTER(ctypes.c_double)
+c_int64_p = ctypes.POINTER(ctypes.c_int64)
+c_uint8_p = ctypes.POINTER(ctypes.c_uint8)
+
+
+@pytest.fixture(scope='module')
+def lib(tmp_path_factory):
+    compiler = shutil.which(os.environ.get('CXX', 'c++'))
+    if compiler is None:
+        pytest.skip('needs a C++ compiler')
+    path = str(tmp_path_factory.mktemp('capi') / 'libcmaxflow.so')
+    subprocess.check_call([compiler, '-O1', '-shared', '-fPIC', '-std=c++11', '-pthread',
+                           '-I' + SRC, os.path.join(SRC, 'cmaxflow.cpp'), '-o', path, '-lrt'])
+    lib = ctypes.CDLL(path)
+    lib.cmaxflow_new.restype = ctypes.c_void_p
+    lib.cmaxflow_free.argtypes = [ctypes.c_void_p]
+    lib.cmaxflow_build.argtypes = [ctypes.c_void_p, ctypes.c_size_t, c_int_p, c_int_p,
+                                   c_double_p, c_double_p, ctypes.c_int, ctypes.c_uint]
+    lib.cmaxflow_build_with_node_capacities.argtypes = [
+        ctypes.c_void_p, ctypes.c_size_t, c_int_p, c_int_p, c_double_p, c_double_p,
+        ctypes.c_size_t, c_int_p, c_double_p, ctypes.c_int, ctypes.c_uint]
+    lib.cmaxflow_set_source_sink.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+    lib.cmaxflow_set_flow_threshold.argtypes = [ctypes.c_void_p, ctypes.c_double]
+    lib.cmaxflow_set_budget.argtypes = [ctypes.c_void_p, ctypes.c_double,
+                                        ctypes.c_ulonglong]
+    lib.cmaxflow_max_preflow.argtypes = [ctypes.c_void_p, ctypes.c_uint, ctypes.c_double,
+                                         ctypes.c_int]
+    lib.cmaxflow_max_preflow.restype = ctypes.c_double
+    lib.cmaxflow_status.argtypes = [ctypes.c_void_p]
+    lib.cmaxflow_upper_bound.argtypes = [ctypes.c_void_p]
+    lib.cmaxflow_upper_bound.restype = ctypes.c_double
+    lib.cmaxflow_node_number.argtypes = [ctypes.c_void_p]
+    lib.cmaxflow_node_number.restype = ctypes.c_size_t
+    lib.cmaxflow_min_cut.argtypes = [ctypes.c_void_p, ctypes.c_int, c_int_p,
+                                     ctypes.c_char_p]
+    lib.cmaxflow_min_cut.restype = ctypes.c_size_t
+    lib.cmaxflow_global_min_cut.argtypes = [ctypes.c_void_p, ctypes.c_double, c_double_p,
+                                            c_int_p, ctypes.c_char_p]
+    lib.cmaxflow_solve_batch.argtypes = [
+        ctypes.c_size_t, c_int64_p, c_int64_p, c_int_p, c_int_p, c_double_p, c_double_p,
+        c_int_p, c_int_p, ctypes.c_double, ctypes.c_uint, c_double_p, c_uint8_p]
+    return lib
+
+
+def array(ctype, values):
+    values = list(values)
+    return (ctype * len(values))(*values)
+
+
+class Solver(object):
+    def __init__(self, lib, G, node_capacities=None, undirected=False):
+        self.lib = lib
+        self.g = lib.cmaxflow_new()
+        edges = list(G.edges.data('capacity'))
+        src = array(ctypes.c_int, (u for u, _, _ in edges))
+        dst = array(ctypes.c_int, (v for _, v, _ in edges))
+        cap = array(ctypes.c_double, (c for _, _, c in edges))
+        rev = cap if undirected else None
+        if node_capacities:
+            nodes = array(ctypes.c_int, node_capacities)
+            node_cap = array(ctypes.c_double, node_capacities.values())
+            ok = lib.cmaxflow_build_with_node_capacities(
+                self.g, len(edges), src, dst, cap, rev, len(nodes), nodes, node_cap, 0, 0)
+        else:
+            ok = lib.cmaxflow_build(self.g, len(edges), src, dst, cap, rev, 0, 0)
+        assert ok == 1
+
+    def __del__(self):
+        self.lib.cmaxflow_free(self.g)
+
+    def cut(self, minimal):
+        n = self.lib.cmaxflow_node_number(self.g)
+        names = (ctypes.c_int * n)()
+        side = ctypes.create_string_buffer(n)
+        written = self.lib.cmaxflow_min_cut(self.g, minimal, names, side)
+        return {names[i] for i in range(written) if side.raw[i]}, \
+            {names[i] for i in range(written) if not side.raw[i]}
+
+    def global_min_cut(self):
+        n = self.lib.cmaxflow_node_number(self.g)
+        names = (ctypes.c_int * n)()
+        side = ctypes.create_string_buffer(n)
+        value = ctypes.c_double()
+        if not self.lib.cmaxflow_global_min_cut(self.g, 1e-6, ctypes.byref(value),
+                                                names, side):
+            return None
+        return value.value, {names[i] for i in range(n) if side.raw[i]}
+
+
+@pytest.mark.parametrize('selection', [HIGHEST_LABEL, FIFO, LIFO])
+@pytest.mark.parametrize('seed', [0, 1])
+def test_max_preflow_and_min_cuts(lib, random_digraph, check_min_cut, selection, seed):
+    G = random_digraph(300, 2000, seed=seed)
+    solver = Solver(lib, G)
+    assert lib.cmaxflow_set_source_sink(solver.g, 0, 1) == 1
+    value = lib.cmaxflow_max_preflow(solver.g, 1, 1e-6, selection)
+    assert lib.cmaxflow_status(solver.g) == OPTIMAL
+    assert lib.cmaxflow_upper_bound(solver.g) == pytest.approx(value)
+    check_min_cut(G, 0, 1, (value, solver.cut(0)), minimal=False)
+    check_min_cut(G, 0, 1, (value, solver.cut(1)), minimal=True)
+
+
+def test_reverse_capacities(lib, check_min_cut):
+    H = nx.gnm_random_graph(200, 800, seed=2)
+    for u, v in H.edges:
+        H[u][v]['capacity'] = float((u * 7 + v * 3) % 13 + 1)
+    solver = Solver(lib, H, undirected=True)
+    assert lib.cmaxflow_set_source_sink(solver.g, 0, 1) == 1
+    value = lib.cmaxflow_max_preflow(solver.g, 1, 1e-6, HIGHEST_LABEL)
+    check_min_cut(H.to_directed(), 0, 1, (value, solver.cut(0)), minimal=False)
+
+
+def test_node_capacities(lib, random_digraph):
+    G = random_digraph(100, 600, seed=3)
+    node_capacities = {v: 4.0 for v in range(2, 40) if v in G}
+    H = nx.DiGraph()
+    for u, v, c in G.edges.data('capacity'):
+        H.add_edge(('out', u) if u in node_capacities else u, v, capacity=c)
+    for v, c in node_capacities.items():
+        H.add_edge(v, ('out', v), capacity=c)
+    solver = Solver(lib, G, node_capacities)
+    assert lib.cmaxflow_node_number(solver.g) == len(G) + len(node_capacities)
+    assert lib.cmaxflow_set_source_sink(solver.g, 0, 1) == 1
+    value = lib.cmaxflow_max_preflow(solver.g, 1, 1e-6, HIGHEST_LABEL)
+    assert value == pytest.approx(nx.maximum_flow_value(H, 0, 1))
+    S, T = solver.cut(0)
+    assert S | T == set(G) and 0 in S and 1 in T
+    # Out-copies are neither sources nor sinks, and no global min cut.
+    assert lib.cmaxflow_set_source_sink(solver.g, len(G), 1) == 0
+    assert solver.global_min_cut() is None
+
+
+def test_early_exit(lib, random_digraph):
+    G = random_digraph(400, 2400, seed=4)
+    expected = nx.maximum_flow_value(G, 0, 1)
+    solver = Solver(lib, G)
+    lib.cmaxflow_set_source_sink(solver.g, 0, 1)
+    lib.cmaxflow_set_flow_threshold(solver.g, expected / 2)
+    value = lib.cmaxflow_max_preflow(solver.g, 1, 1e-6, HIGHEST_LABEL)
+    assert lib.cmaxflow_status(solver.g) == THRESHOLD_REACHED
+    assert expected / 2 <= value <= expected + 1e-9
+    assert lib.cmaxflow_upper_bound(solver.g) >= expected - 1e-9
+
+    lib.cmaxflow_set_flow_threshold(solver.g, 0.0)
+    lib.cmaxflow_set_budget(solver.g, 0.0, 1)
+    value = lib.cmaxflow_max_preflow(solver.g, 1, 1e-6, HIGHEST_LABEL)
+    assert lib.cmaxflow_status(solver.g) == WORK_LIMIT
+    assert value <= expected + 1e-9 <= lib.cmaxflow_upper_bound(solver.g) + 2e-9
+    S, _ = solver.cut(0)
+    assert cut_capacity(G, S) >= expected - 1e-9
+
+
+def test_global_min_cut(lib):
+    G = nx.gnm_random_graph(9, 30, seed=5, directed=True)
+    for u, v in G.edges:
+        G[u][v]['capacity'] = float((u * 5 + v) % 7 + 1)
+    solver = Solver(lib, G)
+    value, S = solver.global_min_cut()
+    expected = min(nx.minimum_cut_value(G, s, t)
+                   for s, t in itertools.permutations(G, 2))
+    assert value == pytest.approx(expected)
+    assert 0 < len(S) < len(G)
+    assert cut_capacity(G, S) == pytest.approx(value)
+
+
+def test_solve_batch(lib, random_digraph):
+    graphs = [random_digraph(n, 4 * n, seed=seed) for seed, n in enumerate([10, 30, 20])]
+    graphs = [nx.convert_node_labels_to_integers(G) for G in graphs]
+    node_offsets, edge_offsets, edges = [0], [0], []
+    for G in graphs:
+        node_offsets.append(node_offsets[-1] + len(G))
+        edges += list(G.edges.data('capacity'))
+        edge_offsets.append(len(edges))
+    flows = (ctypes.c_double * len(graphs))()
+    side = (ctypes.c_uint8 * node_offsets[-1])()
+    ok = lib.cmaxflow_solve_batch(
+        len(graphs), array(ctypes.c_int64, node_offsets), array(ctypes.c_int64, edge_offsets),
+        array(ctypes.c_int, (u for u, _, _ in edges)),
+        array(ctypes.c_int, (v for _, v, _ in edges)),
+        array(ctypes.c_double, (c for _, _, c in edges)), None,
+        array(ctypes.c_int, [0] * len(graphs)), array(ctypes.c_int, [1] * len(graphs)),
+        1e-6, 0, flows, side)
+    assert ok == 1
+    for k, G in enumerate(graphs):
+        assert flows[k] == pytest.approx(nx.maximum_flow_value(G, 0, 1))
+        S = {v for v in G if side[node_offsets[k] + v]}
+        assert 0 in S and 1 not in S
+        assert cut_capacity(G, S) == pytest.approx(flows[k])
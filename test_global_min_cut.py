@@ -0,0 +1,123 @@
+import itertools
+import random
+
+import networkx as nx
+import pytest
+
+from conftest import cut_capacity
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def brute_force(G):
+    """Smallest capacity of the edges from S to T over all partitions."""
+    nodes = sorted(G)
+    return min(cut_capacity(G, set(S))
+               for k in range(1, len(nodes))
+               for S in itertools.combinations(nodes, k))
+
+
+def max_flow_reference(G):
+    """2(n - 1) max flows: some node is on either side of the cut as v."""
+    v = min(G)
+    return min(min(nx.minimum_cut_value(G, v, t), nx.minimum_cut_value(G, t, v))
+               for t in G if t != v)
+
+
+def global_min_cut(G, **kwargs):
+    g = CythonMaxflowGraph()
+    s, t = sorted(G)[:2]
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    return g, g.global_min_cut(**kwargs)
+
+
+def check_cut(G, result, expected):
+    value, (S, T) = result
+    assert value == pytest.approx(expected)
+    assert S | T == set(G) and not S & T and S and T
+    assert cut_capacity(G, S) == pytest.approx(value)
+
+
+def small_digraph(n, p, seed, integer):
+    rng = random.Random(seed)
+    G = nx.gnp_random_graph(n, p, seed=seed, directed=True)
+    G.remove_nodes_from([v for v in list(G) if G.degree(v) == 0])
+    for u, v in G.edges:
+        G[u][v]['capacity'] = float(rng.randint(1, 9)) if integer else rng.uniform(0.1, 9)
+    return G
+
+
+@pytest.mark.parametrize('integer', [True, False])
+@pytest.mark.parametrize('seed', range(40))
+def test_small_graphs_against_brute_force(seed, integer):
+    G = small_digraph(random.Random(seed).randint(2, 9), 0.4, seed, integer)
+    if len(G) < 2:
+        return
+    _, result = global_min_cut(G)
+    check_cut(G, result, brute_force(G))
+
+
+@pytest.mark.parametrize('n,m,seed', [(30, 150, 0), (60, 400, 1), (100, 1000, 2)])
+def test_against_networkx_max_flows(random_digraph, n, m, seed):
+    G = random_digraph(n, m, seed=seed)
+    _, result = global_min_cut(G)
+    check_cut(G, result, max_flow_reference(G))
+
+
+def test_undirected_graph():
+    H = nx.connected_watts_strogatz_graph(40, 4, 0.3, seed=3)
+    for u, v in H.edges:
+        H[u][v]['capacity'] = float((u + 2 * v) % 5 + 1)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(H), 0, 1)
+    value, (S, T) = g.global_min_cut()
+    assert value == pytest.approx(nx.stoer_wagner(H, weight='capacity')[0])
+    check_cut(H.to_directed(), (value, (S, T)), value)
+
+
+def test_one_way_and_disconnected_graphs():
+    # Nothing goes from {2, 3} back to {0, 1}, or between two components.
+    G = nx.DiGraph()
+    G.add_edge(0, 1, capacity=5.0)
+    G.add_edge(1, 0, capacity=5.0)
+    G.add_edge(1, 2, capacity=1.0)
+    G.add_edge(2, 3, capacity=5.0)
+    G.add_edge(3, 2, capacity=5.0)
+    _, result = global_min_cut(G)
+    check_cut(G, result, 0.0)
+    assert result[1][1] == {0, 1}
+    G.remove_edge(1, 2)
+    G.add_edge(4, 5, capacity=2.0)
+    _, result = global_min_cut(G)
+    check_cut(G, result, 0.0)
+
+
+@pytest.mark.parametrize('num_threads', [1, 2, 0])
+def test_independent_of_threads(random_digraph, num_threads):
+    G = random_digraph(3000, 15000, seed=4)
+    # Every node gets a heavy ring edge so that the cut is not a single node.
+    nodes = sorted(G)
+    for u, v in zip(nodes, nodes[1:] + nodes[:1]):
+        G.add_edge(u, v, capacity=100.0)
+    _, result = global_min_cut(G, num_threads=num_threads)
+    _, reference = global_min_cut(G, num_threads=1)
+    assert result[0] == reference[0]
+    check_cut(G, result, reference[0])
+
+
+def test_max_preflow_after_global_min_cut(random_digraph, check_min_cut):
+    G = random_digraph(200, 1200, seed=5)
+    g, first = global_min_cut(G)
+    assert g.max_preflow() == pytest.approx(nx.maximum_flow_value(G, 0, 1))
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+    check_cut(G, g.global_min_cut(), first[0])
+
+
+def test_rejected_graphs():
+    g = CythonMaxflowGraph()
+    g.from_py_object([(0, 0, {'capacity': 1.0})], 0, 0)
+    with pytest.raises(ValueError):
+        g.global_min_cut()
+    g.from_py_object([(0, 1, {'capacity': 1.0}), (1, 2, {'capacity': 1.0})], 0, 2,
+                     node_capacities={1: 1.0})
+    with pytest.raises(ValueError):
+        g.global_min_cut()
@@ -0,0 +1,67 @@
+import random
+
+import networkx as nx
+import pytest
+
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def matching_digraph(left, right, degree, seed):
+    """s -> U -> V -> t with unit capacities; U = 0 .. left-1, V after U."""
+    rng = random.Random(seed)
+    s, t = left + right, left + right + 1
+    G = nx.DiGraph()
+    for u in range(left):
+        G.add_edge(s, u, capacity=1.0)
+        for _ in range(degree):
+            G.add_edge(u, left + rng.randrange(right), capacity=1.0)
+    for v in range(left, left + right):
+        G.add_edge(v, t, capacity=1.0)
+    return G, s, t
+
+
+@pytest.mark.parametrize('left,right,degree,seed', [
+    (50, 50, 1, 0), (200, 150, 2, 1), (300, 300, 3, 2), (1000, 1200, 2, 3)])
+def test_matching_matches_networkx(check_min_cut, left, right, degree, seed):
+    G, s, t = matching_digraph(left, right, degree, seed)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    matching, cut = g.bipartite_matching()
+
+    U = list(G.successors(s))
+    B = nx.Graph((u, v) for u in U for v in G.successors(u))
+    B.add_nodes_from(U)
+    expected = len(nx.bipartite.hopcroft_karp_matching(B, top_nodes=U)) // 2
+    assert len(matching) == expected
+    assert len({u for u, _ in matching}) == expected
+    assert len({v for _, v in matching}) == expected
+    for u, v in matching:
+        assert G.has_edge(u, v)
+    check_min_cut(G, s, t, cut, minimal=False)
+    assert g.status()['status'] == 'optimal'
+    assert g.status()['upper_bound'] == expected
+
+
+def test_matching_agrees_with_max_preflow():
+    G, s, t = matching_digraph(400, 400, 2, seed=4)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    matching, _ = g.bipartite_matching()
+    assert len(matching) == g.max_preflow()
+
+
+@pytest.mark.parametrize('change', ['capacity', 'inner_edge', 'back_edge'])
+def test_matching_rejects_other_graphs(change):
+    G, s, t = matching_digraph(20, 20, 2, seed=5)
+    if change == 'capacity':
+        G[s][0]['capacity'] = 2.0
+    elif change == 'inner_edge':
+        G.add_edge(0, 1, capacity=1.0)
+    else:
+        G.add_edge(t, 0, capacity=1.0)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    with pytest.raises(ValueError):
+        g.bipartite_matching()
+    # max_preflow still handles it.
+    assert g.max_preflow() == pytest.approx(nx.maximum_flow_value(G, s, t))
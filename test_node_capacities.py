@@ -0,0 +1,96 @@
+import random
+
+import networkx as nx
+import pytest
+
+from conftest import cut_capacity, reference_cuts
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def random_node_capacities(G, s, t, count, seed):
+    rng = random.Random(seed)
+    nodes = sorted(v for v in G if v not in (s, t))
+    return {v: float(rng.randint(1, 30)) for v in rng.sample(nodes, count)}
+
+
+def split_nodes(G, node_capacities):
+    """NetworkX reference: node v becomes v -> ('out', v) with its capacity."""
+    H = nx.DiGraph()
+    H.add_nodes_from(G)
+    out = {v: ('out', v) if v in node_capacities else v for v in G}
+    for u, v, c in G.edges.data('capacity'):
+        H.add_edge(out[u], v, capacity=c)
+    for v, c in node_capacities.items():
+        H.add_edge(v, out[v], capacity=c)
+    return H
+
+
+def solve(G, s, t, node_capacities, **kwargs):
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t, node_capacities=node_capacities,
+                     **kwargs)
+    return g
+
+
+@pytest.mark.parametrize('n,m,count,seed', [(50, 300, 10, 0), (300, 2000, 100, 1),
+                                            (1000, 8000, 999, 2)])
+def test_node_capacities_match_networkx(random_digraph, n, m, count, seed):
+    G = random_digraph(n, m, seed=seed)
+    s, t = 0, 1
+    node_capacities = random_node_capacities(G, s, t, min(count, len(G) - 2), seed)
+    H = split_nodes(G, node_capacities)
+    expected, smallest, largest = reference_cuts(H, s, t)
+
+    g = solve(G, s, t, node_capacities)
+    assert g.max_preflow() == pytest.approx(expected)
+    value, (S, T) = g.min_cut()
+    assert value == pytest.approx(expected)
+    assert S | T == set(G) and not S & T
+    assert S == largest & set(G)
+    # The capacities of the cut nodes and of the cut edges make up the cut.
+    cut = g.cut_nodes()
+    assert cut <= S and cut <= set(node_capacities)
+    S_split = S | {('out', v) for v in S if v in node_capacities and v not in cut}
+    assert cut_capacity(H, S_split) == pytest.approx(expected)
+
+    value, (S, T) = g.min_cut(minimal=True)
+    assert value == pytest.approx(expected)
+    assert S == smallest & set(G)
+
+
+@pytest.mark.parametrize('num_threads', [1, 2, 0])
+def test_node_capacities_independent_of_threads(random_digraph, num_threads):
+    G = random_digraph(500, 4000, seed=3)
+    node_capacities = random_node_capacities(G, 0, 1, 200, seed=3)
+    expected = nx.maximum_flow_value(split_nodes(G, node_capacities), 0, 1)
+    g = solve(G, 0, 1, node_capacities, num_threads=num_threads)
+    assert g.max_preflow() == pytest.approx(expected)
+
+
+def test_source_and_sink_capacities_are_ignored(check_min_cut):
+    G = nx.DiGraph()
+    G.add_edge(0, 2, capacity=5.0)
+    G.add_edge(2, 1, capacity=5.0)
+    G.add_edge(0, 3, capacity=1.0)
+    G.add_edge(3, 1, capacity=1.0)
+    g = solve(G, 0, 1, {0: 1.0, 1: 1.0, 2: 2.0})
+    assert g.max_preflow() == 3.0
+    assert g.min_cut() == (3.0, ({0, 2, 3}, {1}))
+    assert g.cut_nodes() == {2}
+
+
+def test_out_copies_are_not_nodes(random_digraph):
+    G = random_digraph(20, 80, seed=4)
+    node_capacities = random_node_capacities(G, 0, 1, 5, seed=4)
+    for s in range(max(G) + 1, max(G) + 1 + len(node_capacities)):
+        with pytest.raises(ValueError):
+            solve(G, s, 1, node_capacities)
+        with pytest.raises(ValueError):
+            solve(G, 0, s, node_capacities)
+
+
+def test_global_min_cut_rejects_node_capacities(random_digraph):
+    G = random_digraph(20, 80, seed=5)
+    g = solve(G, 0, 1, random_node_capacities(G, 0, 1, 5, seed=5))
+    with pytest.raises(ValueError):
+        g.global_min_cut()
@@ -0,0 +1,70 @@
+import multiprocessing
+
+import networkx as nx
+import pytest
+
+from conftest import make_random_digraph, reference_cuts
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+THREADS = [1, 2, 4, 0]
+
+
+def grid_digraph(rows, columns):
+    """Grid with the source and sink in opposite corners: deep searches."""
+    G = nx.convert_node_labels_to_integers(nx.grid_2d_graph(rows, columns).to_directed())
+    for u, v in G.edges:
+        G[u][v]['capacity'] = float((u * 31 + v * 17) % 9 + 1)
+    return G, 0, len(G) - 1
+
+
+@pytest.fixture(scope='module')
+def large_graphs():
+    # n + m is above the grain (16384) from which the searches run in parallel.
+    graphs = [(make_random_digraph(6000, 24000, seed=1), 0, 1), grid_digraph(120, 100)]
+    return [(G, s, t, reference_cuts(G, s, t)) for G, s, t in graphs]
+
+
+@pytest.mark.parametrize('num_threads', THREADS)
+@pytest.mark.parametrize('selection', ['highest_label', 'fifo'])
+def test_results_independent_of_threads(large_graphs, num_threads, selection):
+    for G, s, t, (value, smallest, largest) in large_graphs:
+        g = CythonMaxflowGraph()
+        g.from_py_object(digraph_to_edge_list(G), s, t)
+        assert g.max_preflow(selection=selection, num_threads=num_threads) \
+            == pytest.approx(value)
+        assert g.min_cut() == (pytest.approx(value), (largest, set(G) - largest))
+        assert g.min_cut(minimal=True) == (pytest.approx(value), (smallest, set(G) - smallest))
+
+
+def test_thread_count_changes_between_solves(large_graphs):
+    G, s, t, (value, smallest, largest) = large_graphs[0]
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    for num_threads in [4, 1, 2, 0, 4]:
+        assert g.max_preflow(num_threads=num_threads) == pytest.approx(value)
+        assert g.min_cut()[1][0] == largest
+        assert g.min_cut(minimal=True)[1][0] == smallest
+
+
+_parent_solver = None
+
+
+def solve_in_child(num_threads):
+    return _parent_solver.max_preflow(num_threads=num_threads)
+
+
+def test_threads_after_fork(large_graphs):
+    # The parent's solver has started its threads; in the children, which
+    # have none of them, the same solver must still run.
+    global _parent_solver
+    G, s, t, (value, _, _) = large_graphs[0]
+    _parent_solver = CythonMaxflowGraph()
+    _parent_solver.from_py_object(digraph_to_edge_list(G), s, t)
+    assert _parent_solver.max_preflow(num_threads=4) == pytest.approx(value)
+    try:
+        with multiprocessing.get_context('fork').Pool(2) as pool:
+            results = pool.map(solve_in_child, [4, 2])
+        assert results == [pytest.approx(value)] * 2
+        assert _parent_solver.max_preflow(num_threads=4) == pytest.approx(value)
+    finally:
+        _parent_solver = None
@@ -0,0 +1,52 @@
+import networkx as nx
+import pytest
+
+from exmodule import CythonGraph, CythonMaxflowGraph, digraph_to_edge_list
+
+THREADS = [1, 2, 3, 8, 0]
+
+
+@pytest.mark.parametrize('num_threads', THREADS)
+def test_build_threads_match_networkx(random_digraph, check_min_cut, num_threads):
+    G = random_digraph(2000, 20000, seed=1)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1, num_threads=num_threads)
+    g.max_preflow()
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+    check_min_cut(G, 0, 1, g.min_cut(minimal=True), minimal=True)
+
+
+def test_build_does_not_depend_on_threads(random_digraph):
+    G = random_digraph(3000, 30000, seed=2)
+    edge_list = digraph_to_edge_list(G)
+    results = []
+    for num_threads in THREADS:
+        g = CythonMaxflowGraph()
+        g.from_py_object(edge_list, 5, 7, num_threads=num_threads)
+        results.append((g.max_preflow(), g.min_cut()))
+        assert str_graph(edge_list, num_threads) == str_graph(edge_list, 1)
+    assert all(r == results[0] for r in results)
+
+
+def str_graph(edge_list, num_threads):
+    g = CythonGraph()
+    g.from_py_object(edge_list, num_threads=num_threads)
+    return (g.get_node_number(), g.get_edge_number(), str(g))
+
+
+@pytest.mark.parametrize('num_threads', THREADS)
+def test_parallel_edges_and_self_loops(check_min_cut, num_threads):
+    # Repeated edges add up, self-loops carry no flow.
+    edge_list = [(0, 1, {'capacity': 2.0}), (0, 1, {'capacity': 3.0}),
+                 (1, 1, {'capacity': 9.0}), (1, 2, {'capacity': 4.0}),
+                 (0, 2, {'capacity': 1.0}), (2, 3, {'capacity': 7.0}),
+                 (1, 3, {'capacity': 1.0}), (3, 3, {'capacity': 5.0})]
+    G = nx.DiGraph()
+    for u, v, d in edge_list:
+        if u != v:
+            c = G[u][v]['capacity'] if G.has_edge(u, v) else 0.0
+            G.add_edge(u, v, capacity=c + d['capacity'])
+    g = CythonMaxflowGraph()
+    g.from_py_object(edge_list, 0, 3, num_threads=num_threads)
+    assert g.max_preflow() == pytest.approx(6.0)
+    check_min_cut(G, 0, 3, g.min_cut(), minimal=False)
@@ -0,0 +1,46 @@
+import pytest
+
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+METHODS = ['none', 'bfs', 'rcm', 'degree']
+
+
+@pytest.mark.parametrize('method', METHODS)
+@pytest.mark.parametrize('num_threads', [1, 4])
+def test_reorder_matches_networkx(random_digraph, check_min_cut, method, num_threads):
+    G = random_digraph(400, 2400, seed=3)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    g.reorder_nodes(method, num_threads=num_threads)
+    g.max_preflow()
+    # Cuts are reported by node names, so they do not depend on the order.
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+    check_min_cut(G, 0, 1, g.min_cut(minimal=True), minimal=True)
+
+
+def test_reorder_twice_and_after_solve(random_digraph, check_min_cut):
+    G = random_digraph(300, 1500, seed=4)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 2, 3)
+    g.max_preflow()
+    g.reorder_nodes('rcm')
+    g.reorder_nodes('degree')
+    g.max_preflow()
+    check_min_cut(G, 2, 3, g.min_cut(), minimal=False)
+
+
+def test_unknown_reorder_method():
+    g = CythonMaxflowGraph()
+    g.from_py_object([(0, 1, {'capacity': 1.0})], 0, 1)
+    with pytest.raises(ValueError):
+        g.reorder_nodes('random')
+
+
+@pytest.mark.parametrize('method', ['none', 'bfs'])
+def test_reorder_without_source_and_sink(method):
+    with pytest.raises(ValueError):
+        CythonMaxflowGraph().reorder_nodes(method)
+    g = CythonMaxflowGraph()
+    g.from_py_object([(0, 1, {'capacity': 1.0})], 0, 0)
+    with pytest.raises(ValueError):
+        g.reorder_nodes(method)
@@ -0,0 +1,106 @@
+import networkx as nx
+import numpy as np
+import pytest
+
+from conftest import reference_cuts
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def solve(G, s, t, method=None, **kwargs):
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t, **kwargs)
+    if method is not None:
+        g.reorder_nodes(method)
+    g.max_preflow()
+    return g
+
+
+def check_csr(residual_graph):
+    names, offsets, dst, residual, out_copy = residual_graph
+    n, m = len(names), len(dst)
+    assert offsets.shape == (n + 1,) and residual.shape == (m,) and out_copy.shape == (n,)
+    assert offsets[0] == 0 and offsets[-1] == m
+    assert np.all(np.diff(offsets.astype(np.int64)) >= 0)
+    assert np.all(dst < n)
+    assert np.all(residual >= -1e-9)
+
+
+def residual_digraph(residual_graph, tol=1e-9):
+    """Open residual edges between the indices of the rows."""
+    names, offsets, dst, residual, _ = residual_graph
+    R = nx.DiGraph()
+    R.add_nodes_from(range(len(names)))
+    for i in range(len(names)):
+        for e in range(offsets[i], offsets[i + 1]):
+            if residual[e] > tol:
+                R.add_edge(i, int(dst[e]))
+    return R
+
+
+@pytest.mark.parametrize('method', [None, 'bfs', 'rcm', 'degree'])
+@pytest.mark.parametrize('seed', [0, 1])
+def test_residual_graph_gives_the_min_cuts(random_digraph, method, seed):
+    G = random_digraph(400, 2400, seed=seed)
+    s, t = 0, 1
+    value, smallest, largest = reference_cuts(G, s, t)
+    result = solve(G, s, t, method).residual_graph()
+    check_csr(result)
+    names, offsets, dst, residual, out_copy = result
+    assert sorted(names) == sorted(G) and not out_copy.any()
+    # Each edge pair keeps its total capacity: c(e) + c(reverse e).
+    assert residual.sum() == pytest.approx(sum(c for _, _, c in G.edges.data('capacity')))
+
+    index = {int(v): i for i, v in enumerate(names)}
+    # A row holds the out-edges of its node and the reverses of its in-edges,
+    # so its residuals add up to the out-capacity plus the excess.
+    excess = {}
+    for v in G:
+        row = slice(offsets[index[v]], offsets[index[v] + 1])
+        out_capacity = sum(c for _, _, c in G.out_edges(v, data='capacity'))
+        excess[v] = residual[row].sum() - out_capacity
+        assert excess[v] >= -1e-6 or v == s
+    assert excess[t] == pytest.approx(value)
+
+    # The max preflow leaves excess at some nodes; like min_cut(minimal=True),
+    # the smallest source side is what the source and those nodes reach.
+    R = residual_digraph(result)
+    roots = [index[v] for v in G if v == s or (v != t and excess[v] > 1e-6)]
+    reached = set(roots).union(*(nx.descendants(R, r) for r in roots))
+    assert {int(names[i]) for i in reached} == smallest
+    T = {int(names[i]) for i in nx.ancestors(R, index[t]) | {index[t]}}
+    assert set(G) - T == largest
+
+
+def test_residual_graph_with_node_capacities(random_digraph):
+    G = random_digraph(100, 600, seed=2)
+    node_capacities = {v: 3.0 for v in range(2, 30) if v in G}
+    g = solve(G, 0, 1, node_capacities=node_capacities)
+    result = g.residual_graph()
+    check_csr(result)
+    names, _, _, residual, out_copy = result
+    assert len(names) == len(G) + len(node_capacities)
+    assert sorted(names[out_copy]) == sorted(node_capacities)
+    assert sorted(names[~out_copy]) == sorted(G)
+    total = sum(c for _, _, c in G.edges.data('capacity')) + sum(node_capacities.values())
+    assert residual.sum() == pytest.approx(total)
+
+
+def test_residual_arrays_are_copies(random_digraph):
+    G = random_digraph(300, 1800, seed=3)
+    g = solve(G, 0, 1)
+    result = g.residual_graph()
+    saved = [a.copy() for a in result]
+    for a in result:
+        assert a.flags['OWNDATA']
+
+    # Changing the graph leaves the returned arrays alone.
+    g.reorder_nodes('degree')
+    g.max_preflow()
+    H = random_digraph(50, 200, seed=4)
+    g.from_py_object(digraph_to_edge_list(H), 0, 1)
+    g.max_preflow()
+    for a, b in zip(result, saved):
+        assert np.array_equal(a, b)
+    del g
+    check_csr(result)
+    assert residual_digraph(result).number_of_nodes() == len(G)
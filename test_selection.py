@@ -0,0 +1,34 @@
+import pytest
+
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+RULES = ['highest_label', 'fifo', 'lifo']
+
+
+@pytest.mark.parametrize('selection', RULES)
+@pytest.mark.parametrize('seed', range(5))
+def test_selection_matches_networkx(random_digraph, check_min_cut, selection, seed):
+    G = random_digraph(150, 900, seed=seed, integer=seed % 2 == 0)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    g.max_preflow(selection=selection)
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+    check_min_cut(G, 0, 1, g.min_cut(minimal=True), minimal=True)
+
+
+@pytest.mark.parametrize('selection', RULES)
+@pytest.mark.parametrize('frequency', [0, 1, 10])
+def test_selection_with_relabel_frequency(random_digraph, check_min_cut, selection,
+                                          frequency):
+    G = random_digraph(300, 1200, seed=7)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 3, 4)
+    g.max_preflow(global_relabel_frequency=frequency, selection=selection)
+    check_min_cut(G, 3, 4, g.min_cut(), minimal=False)
+
+
+def test_unknown_selection():
+    g = CythonMaxflowGraph()
+    g.from_py_object([(0, 1, {'capacity': 1.0})], 0, 1)
+    with pytest.raises(ValueError):
+        g.max_preflow(selection='random')
@@ -0,0 +1,109 @@
+import multiprocessing
+import os
+import struct
+
+import networkx as nx
+import pytest
+
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list, unlink_shared
+
+# Offsets in the segment header (see SharedGraphHeader in src/shared.h) and
+# of Edge<double>::dst
+NODE_NUMBER, EDGE_NUMBER, OFFSETS_OFFSET, EDGES_OFFSET = 16, 24, 40, 48
+EDGE_DST = 8
+
+
+@pytest.fixture
+def segment():
+    name = '/cmaxflow_test_%d' % os.getpid()
+    unlink_shared(name)
+    yield name
+    unlink_shared(name)
+
+
+def exported(G, name):
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    g.export_shared(name)
+    return g
+
+
+def attach_and_solve(name, s, t):
+    g = CythonMaxflowGraph()
+    g.attach_shared(name, s, t)
+    return g.max_preflow(), g.min_cut()
+
+
+def test_attach_round_trip(random_digraph, check_min_cut, segment):
+    G = random_digraph(200, 1200, seed=1)
+    exported(G, segment)
+    for s, t in [(0, 1), (2, 3), (5, 0)]:
+        value, cut = attach_and_solve(segment, s, t)
+        assert value == pytest.approx(nx.maximum_flow_value(G, s, t))
+        check_min_cut(G, s, t, cut, minimal=False)
+
+
+def test_attach_from_other_processes(random_digraph, segment):
+    G = random_digraph(200, 1200, seed=2)
+    exported(G, segment)
+    pairs = [(0, t) for t in range(1, 9)]
+    with multiprocessing.get_context('fork').Pool(2) as pool:
+        results = pool.starmap(attach_and_solve, [(segment, s, t) for s, t in pairs])
+    for (s, t), (value, _) in zip(pairs, results):
+        assert value == pytest.approx(nx.maximum_flow_value(G, s, t))
+
+
+def test_exported_graph_outlives_the_exporter(random_digraph, segment):
+    G = random_digraph(100, 500, seed=3)
+    g = exported(G, segment)
+    g.from_py_object([(0, 1, {'capacity': 1.0})], 0, 1)
+    del g
+    value, _ = attach_and_solve(segment, 0, 1)
+    assert value == pytest.approx(nx.maximum_flow_value(G, 0, 1))
+
+
+def test_export_and_unlink(random_digraph, segment):
+    G = random_digraph(50, 200, seed=4)
+    exported(G, segment)
+    with pytest.raises(OSError):
+        exported(G, segment)
+    assert unlink_shared(segment)
+    assert not unlink_shared(segment)
+    with pytest.raises(OSError):
+        attach_and_solve(segment, 0, 1)
+
+
+def read_u64(path, offset):
+    with open(path, 'rb') as f:
+        f.seek(offset)
+        return struct.unpack('<Q', f.read(8))[0]
+
+
+def write_u64(path, offset, value):
+    with open(path, 'r+b') as f:
+        f.seek(offset)
+        f.write(struct.pack('<Q', value))
+
+
+@pytest.mark.skipif(not os.path.isdir('/dev/shm'), reason='needs /dev/shm')
+@pytest.mark.parametrize('field', ['node_number', 'edge_number', 'offsets_offset',
+                                   'last_offset', 'dst', 'magic'])
+def test_attach_rejects_broken_segments(random_digraph, segment, field):
+    G = random_digraph(50, 200, seed=5)
+    exported(G, segment)
+    path = '/dev/shm' + segment
+    n = read_u64(path, NODE_NUMBER)
+    if field == 'node_number':
+        write_u64(path, NODE_NUMBER, n + 1)
+    elif field == 'edge_number':
+        write_u64(path, EDGE_NUMBER, 1 << 40)
+    elif field == 'offsets_offset':
+        write_u64(path, OFFSETS_OFFSET, read_u64(path, EDGES_OFFSET) + 8)
+    elif field == 'last_offset':
+        write_u64(path, read_u64(path, OFFSETS_OFFSET) + 8 * n, 3)
+    elif field == 'dst':
+        write_u64(path, read_u64(path, EDGES_OFFSET) + EDGE_DST, n)
+    else:
+        write_u64(path, 0, 0)
+    with pytest.raises(OSError):
+        attach_and_solve(segment, 0, 1)
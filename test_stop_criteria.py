@@ -0,0 +1,81 @@
+import networkx as nx
+import pytest
+
+from conftest import cut_capacity
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def solve(G, s, t, **kwargs):
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), s, t)
+    g.max_preflow(**kwargs)
+    return g
+
+
+def check_bounds(G, s, t, g, status):
+    expected = nx.maximum_flow_value(G, s, t)
+    report = g.status()
+    assert report['status'] == status
+    assert report['lower_bound'] <= expected + 1e-9
+    assert report['upper_bound'] >= expected - 1e-9
+    # The cut of an early exit is a real cut, so it bounds the flow too.
+    _, (S, T) = g.min_cut()
+    assert s in S and t in T and S | T == set(G)
+    assert cut_capacity(G, S) >= expected - 1e-9
+    return expected, report
+
+
+def test_status_before_solve():
+    g = CythonMaxflowGraph()
+    g.from_py_object([(0, 1, {'capacity': 1.0})], 0, 1)
+    assert g.status() is None
+
+
+@pytest.mark.parametrize('seed', [0, 1, 2, 4])
+def test_threshold_reached(random_digraph, seed):
+    G = random_digraph(400, 2400, seed=seed)
+    threshold = nx.maximum_flow_value(G, 0, 1) / 2
+    g = solve(G, 0, 1, flow_threshold=threshold)
+    _, report = check_bounds(G, 0, 1, g, 'threshold_reached')
+    assert report['lower_bound'] >= threshold
+
+
+@pytest.mark.parametrize('seed', [0, 1, 2, 4])
+def test_threshold_unreachable(random_digraph, seed):
+    G = random_digraph(400, 2400, seed=seed)
+    threshold = nx.maximum_flow_value(G, 0, 1) + 10
+    g = solve(G, 0, 1, flow_threshold=threshold)
+    _, report = check_bounds(G, 0, 1, g, 'threshold_unreachable')
+    assert report['upper_bound'] < threshold
+
+
+def test_threshold_equal_to_max_flow(random_digraph):
+    G = random_digraph(400, 2400, seed=9)
+    expected = nx.maximum_flow_value(G, 0, 1)
+    g = solve(G, 0, 1, flow_threshold=expected)
+    _, report = check_bounds(G, 0, 1, g, 'threshold_reached')
+    assert report['lower_bound'] == pytest.approx(expected)
+
+
+@pytest.mark.parametrize('work_limit', [1, 100, 1000])
+def test_work_limit(random_digraph, work_limit):
+    G = random_digraph(500, 3000, seed=5)
+    g = solve(G, 0, 1, work_limit=work_limit)
+    check_bounds(G, 0, 1, g, 'work_limit')
+
+
+def test_time_limit(random_digraph):
+    G = random_digraph(500, 3000, seed=6)
+    g = solve(G, 0, 1, time_limit=1e-9)
+    check_bounds(G, 0, 1, g, 'time_limit')
+
+
+def test_solve_again_without_limits(random_digraph, check_min_cut):
+    G = random_digraph(500, 3000, seed=7)
+    g = solve(G, 0, 1, work_limit=10)
+    assert g.status()['status'] == 'work_limit'
+    g.max_preflow()
+    expected, report = check_bounds(G, 0, 1, g, 'optimal')
+    assert report['lower_bound'] == pytest.approx(expected)
+    assert report['upper_bound'] == pytest.approx(expected)
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
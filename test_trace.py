@@ -0,0 +1,56 @@
+import json
+
+from exmodule import CythonMaxflowGraph, digraph_to_edge_list
+
+
+def trace_events(g):
+    trace = json.loads(g.trace_json())
+    return trace['traceEvents']
+
+
+def test_trace_records_the_phases(random_digraph, check_min_cut):
+    G = random_digraph(400, 2400, seed=1)
+    g = CythonMaxflowGraph()
+    g.enable_trace()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    g.max_preflow()
+    # Tracing does not change the result.
+    check_min_cut(G, 0, 1, g.min_cut(), minimal=False)
+
+    events = trace_events(g)
+    names = {e['name'] for e in events}
+    assert {'Build', 'InitBuckets', 'MaxPreFlow', 'GlobalRelabeling', 'MinCut'} <= names
+    for e in events:
+        assert e['ph'] == 'X' and e['dur'] >= 0 and e['ts'] >= 0
+    # Each span ends inside the MaxPreFlow span if it starts inside it.
+    solve = next(e for e in events if e['name'] == 'MaxPreFlow')
+    for e in events:
+        if e['name'] in ('GlobalRelabeling', 'Discharge', 'GapHeuristic') \
+                and e['ts'] >= solve['ts']:
+            assert e['ts'] + e['dur'] <= solve['ts'] + solve['dur'] + 1e-3
+
+
+def test_trace_ring_buffer_keeps_the_last_spans(random_digraph):
+    G = random_digraph(400, 2400, seed=2)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    g.enable_trace(3)
+    g.max_preflow()
+    g.min_cut()
+    events = trace_events(g)
+    assert len(events) == 3
+    assert events[-1]['name'] == 'MinCut'
+
+
+def test_disabled_trace_records_nothing(random_digraph):
+    G = random_digraph(200, 1000, seed=3)
+    g = CythonMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    assert trace_events(g) == []
+    g.enable_trace()
+    g.max_preflow()
+    recorded = len(trace_events(g))
+    assert recorded > 0
+    g.disable_trace()
+    g.max_preflow()
+    assert len(trace_events(g)) == recorded
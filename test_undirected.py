@@ -0,0 +1,105 @@
+import random
+
+import networkx as nx
+import pytest
+
+from exmodule import CythonGraph, CythonMaxflowGraph, digraph_to_edge_list
+
+
+def solve(edge_list, s, t):
+    g = CythonMaxflowGraph()
+    g.from_py_object(edge_list, s, t)
+    g.max_preflow()
+    return g
+
+
+def random_graph(n, m, seed):
+    rng = random.Random(seed)
+    G = nx.Graph()
+    for _ in range(m):
+        u, v = rng.randrange(n), rng.randrange(n)
+        if u != v:
+            G.add_edge(u, v, capacity=float(rng.randint(1, 20)))
+    return G
+
+
+@pytest.mark.parametrize('n,m,seed', [(50, 150, 0), (400, 1600, 1), (2000, 8000, 2)])
+def test_undirected_matches_networkx(check_min_cut, n, m, seed):
+    G = random_graph(n, m, seed)
+    edge_list = digraph_to_edge_list(G)
+    assert len(edge_list) == G.number_of_edges()
+    g = solve(edge_list, 0, 1)
+    # An undirected edge is a pair of opposite directed edges.
+    D = G.to_directed()
+    check_min_cut(D, 0, 1, g.min_cut(), minimal=False)
+    check_min_cut(D, 0, 1, g.min_cut(minimal=True), minimal=True)
+
+
+@pytest.mark.parametrize('seed', [0, 1, 2])
+def test_fold_reverse_matches_networkx(random_digraph, check_min_cut, seed):
+    # Dense enough that many edges have their reverse edge in the graph.
+    G = random_digraph(100, 1500, seed=seed)
+    folded = digraph_to_edge_list(G, fold_reverse=True)
+    reciprocal = sum(1 for u, v in G.edges if G.has_edge(v, u))
+    assert reciprocal > 0
+    assert len(folded) == G.number_of_edges() - reciprocal // 2
+    for edge_list, minimal in [(digraph_to_edge_list(G), False), (folded, False),
+                               (folded, True)]:
+        g = solve(edge_list, 0, 1)
+        check_min_cut(G, 0, 1, g.min_cut(minimal=minimal), minimal=minimal)
+
+
+def test_fold_reverse_shares_edge_pairs():
+    G = nx.DiGraph()
+    G.add_edge(0, 1, capacity=1.0)
+    G.add_edge(1, 0, capacity=2.0)
+    G.add_edge(1, 2, capacity=3.0)
+    edge_numbers = []
+    for fold_reverse in (False, True):
+        g = CythonGraph()
+        g.from_py_object(digraph_to_edge_list(G, fold_reverse=fold_reverse))
+        edge_numbers.append(g.get_edge_number())
+    assert edge_numbers == [6, 4]
+
+
+@pytest.mark.parametrize('directed,fold_reverse', [(False, False), (True, False),
+                                                    (True, True)])
+def test_integer_capacities(check_min_cut, directed, fold_reverse):
+    G = nx.DiGraph() if directed else nx.Graph()
+    G.add_edge(0, 2, capacity=3)
+    G.add_edge(2, 0, weight=1, capacity=2)
+    G.add_edge(2, 1, capacity=4)
+    G.add_edge(0, 3, capacity=2)
+    G.add_edge(3, 1, capacity=5)
+    edge_list = digraph_to_edge_list(G, fold_reverse=fold_reverse)
+    for _, _, data in edge_list:
+        assert all(isinstance(c, float) for c in data.values())
+    g = solve(edge_list, 0, 1)
+    D = G if directed else G.to_directed()
+    check_min_cut(D, 0, 1, g.min_cut(), minimal=False)
+
+
+def test_other_capacity_attribute(check_min_cut):
+    G = nx.DiGraph()
+    G.add_edge(0, 2, weight=3, capacity=100)
+    G.add_edge(2, 1, weight=4)
+    G.add_edge(0, 1, weight=1)
+    g = solve(digraph_to_edge_list(G, capacity='weight'), 0, 1)
+    assert g.min_cut()[0] == 4.0
+
+
+@pytest.mark.parametrize('edge', [(0, 1), 5, (0, 1, {}), (0, 1, {'capacity': 'x'}),
+                                  (0, 'a', {'capacity': 1.0})])
+def test_malformed_edge_list(edge):
+    edge_list = [(0, 1, {'capacity': 1.0}), edge]
+    with pytest.raises(ValueError):
+        CythonGraph().from_py_object(edge_list)
+    with pytest.raises(ValueError):
+        CythonMaxflowGraph().from_py_object(edge_list, 0, 1)
+
+
+@pytest.mark.parametrize('s,t', [(0, 7), (7, 1), (-1, 1)])
+def test_missing_source_or_sink(s, t):
+    g = CythonMaxflowGraph()
+    with pytest.raises(ValueError):
+        g.from_py_object([(0, 1, {'capacity': 1.0}), (1, 2, {'capacity': 1.0})], s, t)
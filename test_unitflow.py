@@ -0,0 +1,42 @@
+import pytest
+
+from exmodule import CythonUnitMaxflowGraph, digraph_to_edge_list
+
+
+@pytest.mark.parametrize('n,m,seed', [(50, 200, 0), (300, 1500, 1), (2000, 12000, 2)])
+def test_unit_flow_matches_networkx(random_digraph, check_min_cut, n, m, seed):
+    G = random_digraph(n, m, seed=seed, max_capacity=1)
+    g = CythonUnitMaxflowGraph()
+    g.from_py_object(digraph_to_edge_list(G), 0, 1)
+    value = g.max_flow()
+    result = g.min_cut()
+    # Same result types as CythonMaxflowGraph
+    assert type(value) is float and type(result[0]) is float
+    assert value == result[0]
+    check_min_cut(G, 0, 1, result, minimal=False)
+
+
+def test_unit_flow_zero_capacities():
+    edge_list = [(0, 1, {'capacity': 1.0}), (1, 3, {'capacity': 0.0}),
+                 (0, 2, {'capacity': 1.0}), (2, 3, {'capacity': 1.0}),
+                 (1, 2, {'capacity': 1.0}), (2, 1, {'capacity': 1.0})]
+    g = CythonUnitMaxflowGraph()
+    g.from_py_object(edge_list, 0, 3)
+    assert g.max_flow() == 1.0
+    value, (S, T) = g.min_cut()
+    assert value == 1.0 and S == {0, 1, 2} and T == {3}
+
+
+@pytest.mark.parametrize('data', [{'capacity': 2.0}, {'capacity': 0.5},
+                                  {'capacity': 1.0, 'reverse_capacity': 1.0}])
+def test_unit_flow_rejects_other_capacities(data):
+    g = CythonUnitMaxflowGraph()
+    with pytest.raises(ValueError):
+        g.from_py_object([(0, 1, {'capacity': 1.0}), (1, 2, data)], 0, 2)
+
+
+@pytest.mark.parametrize('s,t', [(0, 99), (99, 1)])
+def test_unit_flow_rejects_unknown_source_or_sink(s, t):
+    g = CythonUnitMaxflowGraph()
+    with pytest.raises(ValueError):
+        g.from_py_object([(0, 1, {'capacity': 1.0})], s, t)